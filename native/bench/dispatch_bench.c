@@ -0,0 +1,145 @@
+// Dispatch benchmark: opcode-heavy workloads run as bytecode, reported as
+// the best of several runs. The Makefile builds it twice, once with
+// -DVM_SWITCH_DISPATCH; given that build's path, it runs it as the baseline
+// and reports the speedup of this one.
+//
+// Usage: dispatch_bench [--raw] [baseline]
+//   --raw prints one time per workload, for a comparing run to read
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vm.h"
+
+#define ROUNDS 5
+#define STATEMENTS 100      // Statements in each work body
+#define WORK_CALLS 100      // Calls of work per drive
+#define DRIVES 200          // Top-level calls of drive
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Script;
+
+static void append(Script* script, const char* text) {
+    size_t n = strlen(text);
+    if (script->length + n + 1 > script->capacity) {
+        script->capacity = script->capacity * 2 + n + 1;
+        script->data = (char*)realloc(script->data, script->capacity);
+        if (!script->data) {
+            fprintf(stderr, "Failed to allocate benchmark script\n");
+            exit(1);
+        }
+    }
+    memcpy(script->data + script->length, text, n + 1);
+    script->length += n;
+}
+
+// Each workload repeats one statement in work, which drive calls
+// WORK_CALLS times and the top level calls DRIVES times
+typedef struct {
+    const char* name;
+    const char* statement;
+} Workload;
+
+static const Workload workloads[] = {
+    // Converting a global (a function, so 0) keeps the parser from folding
+    // the arithmetic without parsing text at runtime
+    {"arithmetic", "x {num} (x {num} leaf) * 2 + 3 - (x {num} leaf) / 4 < 5;"},
+    {"calls", "leaf;"},
+    {"globals", "x {num} leaf == work;"},
+};
+
+#define WORKLOAD_COUNT (int)(sizeof(workloads) / sizeof(workloads[0]))
+
+static char* build_script(const Workload* workload) {
+    Script script = {NULL, 0, 0};
+    append(&script, "function leaf { nothing; }\n");
+    append(&script, "function work {\n");
+    for (int i = 0; i < STATEMENTS; i++) {
+        append(&script, "  ");
+        append(&script, workload->statement);
+        append(&script, "\n");
+    }
+    append(&script, "}\nfunction drive {\n");
+    for (int i = 0; i < WORK_CALLS; i++) append(&script, "  work;\n");
+    append(&script, "}\n");
+    for (int i = 0; i < DRIVES; i++) append(&script, "drive;\n");
+    return script.data;
+}
+
+static double bench_workload(const Workload* workload) {
+    char* script = build_script(workload);
+    VM vm;
+    initVM(&vm);
+    if (!compile(&vm, script)) {
+        fprintf(stderr, "Benchmark script '%s' failed to compile\n", workload->name);
+        exit(1);
+    }
+
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now_ms();
+        run_chunk(&vm, vm.chunk);
+        double elapsed = now_ms() - start;
+        if (round == 0 || elapsed < best) best = elapsed;
+    }
+
+    freeVM(&vm);
+    free(script);
+    return best;
+}
+
+// Times printed by baseline --raw, or false if it could not be run
+static bool run_baseline(const char* baseline, double* times) {
+    char command[1024];
+    snprintf(command, sizeof(command), "%s --raw", baseline);
+    FILE* pipe = popen(command, "r");
+    if (!pipe) return false;
+
+    bool ok = true;
+    for (int i = 0; i < WORKLOAD_COUNT && ok; i++) {
+        ok = fscanf(pipe, "%lf", &times[i]) == 1;
+    }
+    return pclose(pipe) == 0 && ok;
+}
+
+int main(int argc, char* argv[]) {
+    bool raw = argc > 1 && strcmp(argv[1], "--raw") == 0;
+    const char* baseline = argc > (raw ? 2 : 1) ? argv[raw ? 2 : 1] : NULL;
+
+    double times[WORKLOAD_COUNT];
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        times[i] = bench_workload(&workloads[i]);
+    }
+
+    if (raw) {
+        for (int i = 0; i < WORKLOAD_COUNT; i++) printf("%f\n", times[i]);
+        return 0;
+    }
+
+    double baseline_times[WORKLOAD_COUNT];
+    bool compare = baseline && run_baseline(baseline, baseline_times);
+    if (baseline && !compare) fprintf(stderr, "Could not run baseline %s\n", baseline);
+
+#ifdef VM_SWITCH_DISPATCH
+    printf("dispatch: switch\n");
+#else
+    printf("dispatch: threaded\n");
+#endif
+    long statements = (long)STATEMENTS * WORK_CALLS * DRIVES;
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        printf("%-11s %8.2f ms (%.2f ns/statement)", workloads[i].name, times[i],
+               times[i] * 1e6 / statements);
+        if (compare) printf("  switch %8.2f ms (%.2fx)", baseline_times[i], baseline_times[i] / times[i]);
+        printf("\n");
+    }
+    return 0;
+}
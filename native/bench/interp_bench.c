@@ -0,0 +1,138 @@
+// Interpreter benchmark: runs the same parsed program through the
+// tree-walking evaluator, the flat tree walker and the bytecode VM and
+// reports the time each takes. Program output goes to /dev/null.
+//
+// Usage: interp_bench [depth] [fanout]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vm.h"
+
+#define DEFAULT_DEPTH 5
+#define DEFAULT_FANOUT 8
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Script;
+
+static void append(Script* script, const char* format, int arg) {
+    char line[256];
+    int n = snprintf(line, sizeof(line), format, arg);
+    if (script->length + n + 1 > script->capacity) {
+        script->capacity = script->capacity * 2 + n + 1;
+        script->data = (char*)realloc(script->data, script->capacity);
+        if (!script->data) {
+            fprintf(stderr, "Failed to allocate benchmark script\n");
+            exit(1);
+        }
+    }
+    memcpy(script->data + script->length, line, n + 1);
+    script->length += n;
+}
+
+// A call tree: each level calls the next fanout times, and the leaves do
+// arithmetic the parser cannot fold away
+static char* build_script(int depth, int fanout) {
+    Script script = {NULL, 0, 0};
+    for (int level = 0; level < depth; level++) {
+        append(&script, "function level%d {\n", level);
+        for (int i = 0; i < fanout; i++) {
+            append(&script, "  level%d;\n", level + 1);
+        }
+        append(&script, "}\n", 0);
+    }
+    append(&script, "function level%d {\n", depth);
+    append(&script, "  text (x {num} \"3\") * 2 + 1 - 4 / 2 == 5;\n", 0);
+    append(&script, "  text (x {num} \"7\") - (x {num} \"2\") * 3;\n", 0);
+    append(&script, "}\n", 0);
+    append(&script, "level0;\n", 0);
+    return script.data;
+}
+
+static double bench_tree_walker(const char* script) {
+    VM vm;
+    initVM(&vm);
+    Lexer lexer;
+    init_lexer(&lexer, script, strlen(script));
+    Parser* parser = create_parser(&lexer, &vm.strings);
+    ASTNode* program = parse_program(parser);
+    free_parser(parser);
+
+    double start = now_ms();
+    execute_program(&vm, program);
+    flush_output(&vm.output);
+    double elapsed = now_ms() - start;
+
+    free_ast(program);
+    freeVM(&vm);
+    return elapsed;
+}
+
+static double bench_flat_walker(const char* script) {
+    VM vm;
+    initVM(&vm);
+    Lexer lexer;
+    init_lexer(&lexer, script, strlen(script));
+    Parser* parser = create_parser(&lexer, &vm.strings);
+    ASTNode* program = parse_program(parser);
+    free_parser(parser);
+    FlatAST* ast = flatten_ast(program);
+
+    double start = now_ms();
+    execute_flat_program(&vm, ast);
+    flush_output(&vm.output);
+    double elapsed = now_ms() - start;
+
+    free_flat_ast(ast);
+    free_ast(program);
+    freeVM(&vm);
+    return elapsed;
+}
+
+static double bench_bytecode(const char* script) {
+    VM vm;
+    initVM(&vm);
+    if (!compile(&vm, script)) {
+        fprintf(stderr, "Benchmark script failed to compile\n");
+        exit(1);
+    }
+
+    double start = now_ms();
+    run_chunk(&vm, vm.chunk);
+    flush_output(&vm.output);
+    double elapsed = now_ms() - start;
+
+    freeVM(&vm);
+    return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    int depth = argc > 1 ? atoi(argv[1]) : DEFAULT_DEPTH;
+    int fanout = argc > 2 ? atoi(argv[2]) : DEFAULT_FANOUT;
+    char* script = build_script(depth, fanout);
+
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Could not redirect output\n");
+        return 1;
+    }
+
+    double walker = bench_tree_walker(script);
+    double flat = bench_flat_walker(script);
+    double bytecode = bench_bytecode(script);
+    fprintf(stderr, "depth %d, fanout %d\n", depth, fanout);
+    fprintf(stderr, "tree walker: %8.2f ms\n", walker);
+    fprintf(stderr, "flat walker: %8.2f ms (%.2fx)\n", flat, walker / flat);
+    fprintf(stderr, "bytecode:    %8.2f ms (%.2fx)\n", bytecode, walker / bytecode);
+
+    free(script);
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Lexer benchmark: lexes one large generated script with tokenize() and
+// with tokenize_parallel() on pools of several sizes, reporting the best
+// of several runs of each. The parallel rows only pull ahead with as many
+// CPUs as threads; the online CPU count is printed with the results.
+//
+// Usage: lex_bench [megabytes]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lexer.h"
+
+#define ROUNDS 5
+#define DEFAULT_MEGABYTES 16
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Statements of every token kind, repeated up to size bytes
+static char* build_script(size_t size, size_t* length) {
+    char* script = (char*)malloc(size + 256);
+    if (!script) {
+        fprintf(stderr, "Failed to allocate benchmark script\n");
+        exit(1);
+    }
+    size_t n = 0;
+    for (int i = 0; n < size; i++) {
+        n += (size_t)sprintf(script + n,
+                             "function f%d {\n  text \"item %d\" + x {num} \"3\" * (2 - 1.5);\n}\nf%d;\n",
+                             i, i, i);
+    }
+    *length = n;
+    return script;
+}
+
+static double bench_serial(const char* script, size_t length, int* tokens) {
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now_ms();
+        Lexer lexer;
+        init_lexer(&lexer, script, length);
+        TokenBuffer* buffer = tokenize(&lexer);
+        double elapsed = now_ms() - start;
+        *tokens = buffer->count;
+        free_token_buffer(buffer);
+        if (round == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static double bench_parallel(const char* script, size_t length, int threads, int tokens) {
+    ThreadPool* pool = create_thread_pool(threads);
+    if (!pool) exit(1);
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now_ms();
+        TokenBuffer* buffer = tokenize_parallel(script, length, pool);
+        double elapsed = now_ms() - start;
+        if (buffer->count != tokens) {
+            fprintf(stderr, "Parallel lexing produced %d tokens, expected %d\n", buffer->count, tokens);
+            exit(1);
+        }
+        free_token_buffer(buffer);
+        if (round == 0 || elapsed < best) best = elapsed;
+    }
+    free_thread_pool(pool);
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    int megabytes = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGABYTES;
+    if (megabytes <= 0) {
+        fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+        return 1;
+    }
+
+    size_t length;
+    char* script = build_script((size_t)megabytes << 20, &length);
+    int tokens;
+    double serial = bench_serial(script, length, &tokens);
+
+    printf("%d MiB, %d tokens, %ld CPUs online\n", megabytes, tokens, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-12s %8.2f ms\n", "tokenize", serial);
+    int thread_counts[] = {1, 2, 4, 8};
+    for (int i = 0; i < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); i++) {
+        double parallel = bench_parallel(script, length, thread_counts[i], tokens);
+        printf("%d %-10s %8.2f ms  %.2fx\n", thread_counts[i],
+               thread_counts[i] == 1 ? "thread" : "threads", parallel, serial / parallel);
+    }
+
+    free(script);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Opcode pair profile: runs a corpus of scripts through a VM built with
+// -DVM_PROFILE_PAIRS and prints the most frequent adjacent instruction
+// pairs, the candidates for superinstructions. Pairs that are already
+// fused show up as the superinstruction and its successor.
+//
+// Usage: opcode_profile [script...]
+//   With no scripts, the corpus mirrors the workloads of the other
+//   benchmarks.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+#include "source.h"
+
+#define TOP_PAIRS 20
+#define REPEAT 20
+
+static const char* corpus[] = {
+    // interp_bench: a call tree with arithmetic leaves
+    "function leaf {\n"
+    "  text (x {num} \"3\") * 2 + 1 - 4 / 2 == 5;\n"
+    "  text (x {num} \"7\") - (x {num} \"2\") * 3;\n"
+    "}\n"
+    "function branch { leaf; leaf; leaf; leaf; }\n"
+    "branch; branch;\n",
+    // print_bench: log lines
+    "function log { text \"request served\"; text 200; text true; }\n"
+    "function batch { log; log; log; log; log; }\n"
+    "batch; batch;\n",
+    // dispatch_bench: arithmetic, calls and global access
+    "function leaf { nothing; }\n"
+    "function work {\n"
+    "  x {num} (x {num} leaf) * 2 + 3 - (x {num} leaf) / 4 < 5;\n"
+    "  leaf; leaf;\n"
+    "  x {num} leaf == work;\n"
+    "}\n"
+    "work; work;\n",
+};
+
+typedef struct {
+    int first;
+    int second;
+    uint64_t count;
+} Pair;
+
+static int compare_pairs(const void* a, const void* b) {
+    uint64_t x = ((const Pair*)a)->count;
+    uint64_t y = ((const Pair*)b)->count;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void profile(const char* script) {
+    VM vm;
+    initVM(&vm);
+    set_output_buffer_size(&vm.output, 0);
+    if (compile(&vm, script)) {
+        for (int i = 0; i < REPEAT; i++) run_chunk(&vm, vm.chunk);
+    } else {
+        fprintf(stderr, "Corpus script failed to compile\n");
+    }
+    freeVM(&vm);
+}
+
+int main(int argc, char* argv[]) {
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Could not redirect output\n");
+        return 1;
+    }
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            Source source;
+            if (!load_source(argv[i], &source)) return 1;
+            profile(source.data);
+            release_source(&source);
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) profile(corpus[i]);
+    }
+
+    Pair* pairs = (Pair*)malloc(256 * 256 * sizeof(Pair));
+    if (!pairs) return 1;
+    int count = 0;
+    uint64_t total = 0;
+    for (int first = 0; first < 256; first++) {
+        for (int second = 0; second < 256; second++) {
+            uint64_t n = opcode_pair_counts[first][second];
+            if (n == 0) continue;
+            pairs[count++] = (Pair){first, second, n};
+            total += n;
+        }
+    }
+    qsort(pairs, count, sizeof(Pair), compare_pairs);
+
+    fprintf(stderr, "%llu instruction pairs\n", (unsigned long long)total);
+    for (int i = 0; i < count && i < TOP_PAIRS; i++) {
+        const char* first = opcode_name(pairs[i].first);
+        const char* second = opcode_name(pairs[i].second);
+        fprintf(stderr, "%6.2f%%  %-20s %s\n", 100.0 * pairs[i].count / total,
+                first ? first : "?", second ? second : "?");
+    }
+    free(pairs);
+    return 0;
+}
@@ -0,0 +1,268 @@
+// Parser benchmark: parses generated scripts from a token buffer and frees
+// the tree, reporting the best of several runs of each step. Scripts are
+// lexed before the clock starts, so only parse_program is timed.
+// Freeing the arena is compared with freeing the same tree allocated one
+// node and one list at a time, the way trees were freed before the arena.
+// A second script of many functions is parsed eagerly, lazily and with
+// its functions split across thread pools of several sizes; the parallel
+// rows only pull ahead with as many CPUs as threads.
+//
+// Usage: parse_bench [statements]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "parser.h"
+
+#define ROUNDS 5
+#define DEFAULT_STATEMENTS 400000
+#define FUNCTIONS 20000
+#define BODY_STATEMENTS 20
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Script;
+
+static void append(Script* script, const char* format, int arg) {
+    char line[256];
+    int n = snprintf(line, sizeof(line), format, arg);
+    if (script->length + n + 1 > script->capacity) {
+        script->capacity = script->capacity * 2 + n + 1;
+        script->data = (char*)realloc(script->data, script->capacity);
+        if (!script->data) {
+            fprintf(stderr, "Failed to allocate benchmark script\n");
+            exit(1);
+        }
+    }
+    memcpy(script->data + script->length, line, n + 1);
+    script->length += n;
+}
+
+// Top-level prints, calls and number conversions in turn
+static char* build_statements(int statements) {
+    Script script = {NULL, 0, 0};
+    for (int i = 0; i < statements; i++) {
+        switch (i % 3) {
+            case 0: append(&script, "text \"line %d\";\n", i); break;
+            case 1: append(&script, "name%d;\n", i); break;
+            case 2: append(&script, "v {num} %d.5;\n", i); break;
+        }
+    }
+    return script.data;
+}
+
+// FUNCTIONS functions of BODY_STATEMENTS statements each, all but the
+// first never called
+static char* build_functions(void) {
+    Script script = {NULL, 0, 0};
+    for (int i = 0; i < FUNCTIONS; i++) {
+        append(&script, "function f%d {\n", i);
+        for (int j = 0; j < BODY_STATEMENTS; j++) {
+            append(&script, "  text \"line %d\" + (x {num} \"2\") * 3;\n", j);
+        }
+        append(&script, "}\n", 0);
+    }
+    append(&script, "f0;\n", 0);
+    return script.data;
+}
+
+static void* allocate(size_t size) {
+    void* memory = malloc(size);
+    if (!memory) {
+        fprintf(stderr, "Failed to allocate benchmark tree\n");
+        exit(1);
+    }
+    return memory;
+}
+
+static ASTNode* copy_tree(const ASTNode* node);
+
+static ASTNode** copy_list(ASTNode** list, int count) {
+    if (count == 0) return NULL;
+    ASTNode** copy = (ASTNode**)allocate(count * sizeof(ASTNode*));
+    for (int i = 0; i < count; i++) copy[i] = copy_tree(list[i]);
+    return copy;
+}
+
+// The tree again with one malloc per node and per list
+static ASTNode* copy_tree(const ASTNode* node) {
+    if (!node) return NULL;
+    ASTNode* copy = (ASTNode*)allocate(sizeof(ASTNode));
+    *copy = *node;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            copy->data.program.statements = copy_list(node->data.program.statements,
+                                                      node->data.program.statement_count);
+            copy->data.program.arena = NULL;
+            break;
+        case NODE_FUNCTION_DEFINITION:
+            copy->data.function_definition.body = copy_tree(node->data.function_definition.body);
+            break;
+        case NODE_TEXT:
+            copy->data.text.expr = copy_tree(node->data.text.expr);
+            break;
+        case NODE_NUMBER_CONVERSION:
+            copy->data.number_conversion.expr = copy_tree(node->data.number_conversion.expr);
+            break;
+        case NODE_GAME_ENGINE:
+            copy->data.game_engine.animations = copy_list(node->data.game_engine.animations,
+                                                          node->data.game_engine.animation_count);
+            copy->data.game_engine.expr = copy_tree(node->data.game_engine.expr);
+            break;
+        case NODE_UNARY:
+            copy->data.unary.operand = copy_tree(node->data.unary.operand);
+            break;
+        case NODE_BINARY:
+            copy->data.binary.left = copy_tree(node->data.binary.left);
+            copy->data.binary.right = copy_tree(node->data.binary.right);
+            break;
+        default:
+            break;
+    }
+    return copy;
+}
+
+// Recursive free of a copy_tree tree
+static void free_tree(ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                free_tree(node->data.program.statements[i]);
+            }
+            free(node->data.program.statements);
+            break;
+        case NODE_FUNCTION_DEFINITION:
+            free_tree(node->data.function_definition.body);
+            break;
+        case NODE_TEXT:
+            free_tree(node->data.text.expr);
+            break;
+        case NODE_NUMBER_CONVERSION:
+            free_tree(node->data.number_conversion.expr);
+            break;
+        case NODE_GAME_ENGINE:
+            for (int i = 0; i < node->data.game_engine.animation_count; i++) {
+                free_tree(node->data.game_engine.animations[i]);
+            }
+            free(node->data.game_engine.animations);
+            free_tree(node->data.game_engine.expr);
+            break;
+        case NODE_UNARY:
+            free_tree(node->data.unary.operand);
+            break;
+        case NODE_BINARY:
+            free_tree(node->data.binary.left);
+            free_tree(node->data.binary.right);
+            break;
+        default:
+            break;
+    }
+    free(node);
+}
+
+// Parse script from a fresh token buffer, timing parse_program only. A
+// lazy parse leaves function bodies for later; given a pool, top-level
+// functions are parsed on it.
+static ASTNode* timed_parse(const char* script, Interner* strings, bool lazy, ThreadPool* pool,
+                            double* elapsed) {
+    Lexer lexer;
+    init_lexer(&lexer, script, strlen(script));
+    Parser* parser = create_buffered_parser(&lexer, strings);
+    if (!parser) exit(1);
+    parser->lazy_functions = lazy;
+    parser->pool = pool;
+
+    double start = now_ms();
+    ASTNode* program = parse_program(parser);
+    *elapsed = now_ms() - start;
+
+    if (parser->had_error) {
+        fprintf(stderr, "Benchmark script failed to parse\n");
+        exit(1);
+    }
+    free_parser(parser);
+    return program;
+}
+
+static void keep_best(double* best, double elapsed, int round) {
+    if (round == 0 || elapsed < *best) *best = elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    int statements = argc > 1 ? atoi(argv[1]) : DEFAULT_STATEMENTS;
+    if (statements <= 0) {
+        fprintf(stderr, "Usage: %s [statements]\n", argv[0]);
+        return 1;
+    }
+
+    Interner strings;
+    init_interner(&strings);
+    char* script = build_statements(statements);
+
+    double parse = 0, arena_free = 0, node_free = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        double elapsed;
+        ASTNode* program = timed_parse(script, &strings, false, NULL, &elapsed);
+        keep_best(&parse, elapsed, round);
+
+        ASTNode* copy = copy_tree(program);
+        double start = now_ms();
+        free_tree(copy);
+        keep_best(&node_free, now_ms() - start, round);
+
+        start = now_ms();
+        free_ast(program);
+        keep_best(&arena_free, now_ms() - start, round);
+    }
+
+    char* functions = build_functions();
+    double eager = 0, lazy = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        double elapsed;
+        free_ast(timed_parse(functions, &strings, false, NULL, &elapsed));
+        keep_best(&eager, elapsed, round);
+        free_ast(timed_parse(functions, &strings, true, NULL, &elapsed));
+        keep_best(&lazy, elapsed, round);
+    }
+
+    int thread_counts[] = {2, 4};
+    double parallel[2] = {0, 0};
+    for (int t = 0; t < 2; t++) {
+        ThreadPool* pool = create_thread_pool(thread_counts[t]);
+        if (!pool) exit(1);
+        for (int round = 0; round < ROUNDS; round++) {
+            double elapsed;
+            free_ast(timed_parse(functions, &strings, false, pool, &elapsed));
+            keep_best(&parallel[t], elapsed, round);
+        }
+        free_thread_pool(pool);
+    }
+
+    printf("%d statements\n", statements);
+    printf("parse:              %8.2f ms\n", parse);
+    printf("free_ast (arena):   %8.2f ms\n", arena_free);
+    printf("free per node:      %8.2f ms\n", node_free);
+    printf("%d functions of %d statements, %ld CPUs online\n", FUNCTIONS, BODY_STATEMENTS,
+           sysconf(_SC_NPROCESSORS_ONLN));
+    printf("parse (eager):      %8.2f ms\n", eager);
+    printf("parse (lazy):       %8.2f ms  %.2fx\n", lazy, eager / lazy);
+    for (int t = 0; t < 2; t++) {
+        printf("parse (%d threads):  %8.2f ms  %.2fx\n", thread_counts[t], parallel[t],
+               eager / parallel[t]);
+    }
+
+    free(functions);
+    free(script);
+    free_interner(&strings);
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Output benchmark: a script that prints many short lines, run as bytecode
+// with the VM's output buffer at several sizes. Size 0 writes every line
+// through, which is one syscall per text statement.
+//
+// Usage: print_bench [batches]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vm.h"
+
+#define DEFAULT_BATCHES 2000
+#define LINES_PER_BATCH 300
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// batch prints LINES_PER_BATCH lines through 100 calls of log
+static char* build_script(int batches) {
+    const char* log = "function log { text \"request served\"; text 200; text true; }\n";
+    const char* call = "log; ";
+    const char* run = "batch;\n";
+    size_t size = strlen(log) + strlen("function batch { }\n") + 100 * strlen(call) +
+                  (size_t)batches * strlen(run) + 1;
+    char* script = (char*)malloc(size);
+    if (!script) exit(1);
+
+    strcpy(script, log);
+    strcat(script, "function batch { ");
+    for (int i = 0; i < 100; i++) strcat(script, call);
+    strcat(script, "}\n");
+    char* end = script + strlen(script);
+    for (int i = 0; i < batches; i++) {
+        memcpy(end, run, strlen(run));
+        end += strlen(run);
+    }
+    *end = '\0';
+    return script;
+}
+
+static double bench_output(const char* script, size_t buffer_size) {
+    VM vm;
+    initVM(&vm);
+    set_output_buffer_size(&vm.output, buffer_size);
+    if (!compile(&vm, script)) {
+        fprintf(stderr, "Benchmark script failed to compile\n");
+        exit(1);
+    }
+
+    double start = now_ms();
+    run_chunk(&vm, vm.chunk);
+    flush_output(&vm.output);
+    double elapsed = now_ms() - start;
+
+    freeVM(&vm);
+    return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    int batches = argc > 1 ? atoi(argv[1]) : DEFAULT_BATCHES;
+    char* script = build_script(batches);
+
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Could not redirect output\n");
+        return 1;
+    }
+
+    static const size_t sizes[] = {0, 4096, OUTPUT_BUFFER_SIZE};
+    long lines = (long)batches * LINES_PER_BATCH;
+    fprintf(stderr, "%ld lines\n", lines);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        double elapsed = bench_output(script, sizes[i]);
+        fprintf(stderr, "buffer %6zu: %8.2f ms (%.1f ns/line)\n",
+                sizes[i], elapsed, elapsed * 1e6 / lines);
+    }
+
+    free(script);
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Register tier benchmark: the dispatch benchmark's workloads compiled for
+// both tiers, reported as the best of several runs of each. The Makefile
+// also builds it with -DVM_COUNT_INSTRUCTIONS; given that build's path, it
+// runs it with --counts and reports how many instructions each tier
+// executes. Times come from this build, which does not count.
+//
+// Usage: register_bench [--counts] [counting build]
+//   --counts prints the instructions per run of each workload, stack tier
+//   then register tier, for a comparing run to read
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "vm.h"
+
+#define ROUNDS 5
+#define STATEMENTS 100      // Statements in each work body
+#define WORK_CALLS 100      // Calls of work per drive
+#define DRIVES 100          // Top-level calls of drive
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Script;
+
+static void append(Script* script, const char* text) {
+    size_t n = strlen(text);
+    if (script->length + n + 1 > script->capacity) {
+        script->capacity = script->capacity * 2 + n + 1;
+        script->data = (char*)realloc(script->data, script->capacity);
+        if (!script->data) {
+            fprintf(stderr, "Failed to allocate benchmark script\n");
+            exit(1);
+        }
+    }
+    memcpy(script->data + script->length, text, n + 1);
+    script->length += n;
+}
+
+// Each workload repeats one statement in work, which drive calls
+// WORK_CALLS times and the top level calls DRIVES times
+typedef struct {
+    const char* name;
+    const char* statement;
+} Workload;
+
+static const Workload workloads[] = {
+    {"arithmetic", "x {num} (x {num} leaf) * 2 + 3 - (x {num} leaf) / 4 < 5;"},
+    {"calls", "leaf;"},
+    {"globals", "x {num} leaf == work;"},
+    {"print", "text (x {num} leaf) + 1;"},
+};
+
+#define WORKLOAD_COUNT (int)(sizeof(workloads) / sizeof(workloads[0]))
+
+typedef enum {
+    TIER_STACK,
+    TIER_REGISTER
+} Tier;
+
+static char* build_script(const Workload* workload) {
+    Script script = {NULL, 0, 0};
+    append(&script, "function leaf { nothing; }\n");
+    append(&script, "function work {\n");
+    for (int i = 0; i < STATEMENTS; i++) {
+        append(&script, "  ");
+        append(&script, workload->statement);
+        append(&script, "\n");
+    }
+    append(&script, "}\nfunction drive {\n");
+    for (int i = 0; i < WORK_CALLS; i++) append(&script, "  work;\n");
+    append(&script, "}\n");
+    for (int i = 0; i < DRIVES; i++) append(&script, "drive;\n");
+    return script.data;
+}
+
+// Best time of ROUNDS runs; instructions gets the count of the last run
+// in a counting build
+static double bench_tier(const char* script, const Workload* workload, Tier tier,
+                         uint64_t* instructions) {
+    VM vm;
+    initVM(&vm);
+    bool ok = tier == TIER_STACK ? compile(&vm, script) : compile_registers(&vm, script);
+    if (!ok) {
+        fprintf(stderr, "Benchmark script '%s' failed to compile\n", workload->name);
+        exit(1);
+    }
+
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+#ifdef VM_COUNT_INSTRUCTIONS
+        executed_instructions = 0;
+#endif
+        double start = now_ms();
+        InterpretResult result = tier == TIER_STACK ? run_chunk(&vm, vm.chunk)
+                                                    : run_register_chunk(&vm, vm.register_chunk);
+        double elapsed = now_ms() - start;
+        if (result != INTERPRET_OK) {
+            fprintf(stderr, "Benchmark script '%s' failed\n", workload->name);
+            exit(1);
+        }
+        if (round == 0 || elapsed < best) best = elapsed;
+    }
+#ifdef VM_COUNT_INSTRUCTIONS
+    *instructions = executed_instructions;
+#else
+    *instructions = 0;
+#endif
+
+    freeVM(&vm);
+    return best;
+}
+
+// Counts printed by counter --counts, or false if it could not be run
+static bool run_counter(const char* counter, uint64_t counts[][2]) {
+    char command[1024];
+    snprintf(command, sizeof(command), "%s --counts", counter);
+    FILE* pipe = popen(command, "r");
+    if (!pipe) return false;
+
+    bool ok = true;
+    for (int i = 0; i < WORKLOAD_COUNT && ok; i++) {
+        unsigned long long stack, registers;
+        ok = fscanf(pipe, "%llu %llu", &stack, &registers) == 2;
+        counts[i][TIER_STACK] = stack;
+        counts[i][TIER_REGISTER] = registers;
+    }
+    return pclose(pipe) == 0 && ok;
+}
+
+int main(int argc, char* argv[]) {
+    bool counts_only = argc > 1 && strcmp(argv[1], "--counts") == 0;
+    const char* counter = !counts_only && argc > 1 ? argv[1] : NULL;
+
+    // The print workload's output is not what is measured
+    int out = dup(STDOUT_FILENO);
+    if (out < 0 || !freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Could not redirect output\n");
+        return 1;
+    }
+
+    double times[WORKLOAD_COUNT][2];
+    uint64_t counts[WORKLOAD_COUNT][2];
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        char* script = build_script(&workloads[i]);
+        for (int tier = TIER_STACK; tier <= TIER_REGISTER; tier++) {
+            times[i][tier] = bench_tier(script, &workloads[i], (Tier)tier, &counts[i][tier]);
+        }
+        free(script);
+    }
+
+    FILE* report = fdopen(out, "w");
+    if (!report) return 1;
+    if (counts_only) {
+        for (int i = 0; i < WORKLOAD_COUNT; i++) {
+            fprintf(report, "%llu %llu\n", (unsigned long long)counts[i][TIER_STACK],
+                    (unsigned long long)counts[i][TIER_REGISTER]);
+        }
+        fclose(report);
+        return 0;
+    }
+
+    bool counted = counter && run_counter(counter, counts);
+    if (counter && !counted) fprintf(stderr, "Could not run counting build %s\n", counter);
+
+    long statements = (long)STATEMENTS * WORK_CALLS * DRIVES;
+    fprintf(report, "%-11s %21s %21s\n", "", "stack", "register");
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        fprintf(report, "%-11s %8.2f ms (%5.2f ns) %8.2f ms (%5.2f ns)  %.2fx", workloads[i].name,
+                times[i][TIER_STACK], times[i][TIER_STACK] * 1e6 / statements,
+                times[i][TIER_REGISTER], times[i][TIER_REGISTER] * 1e6 / statements,
+                times[i][TIER_STACK] / times[i][TIER_REGISTER]);
+        if (counted) {
+            fprintf(report, "  %.2f vs %.2f instructions/statement",
+                    (double)counts[i][TIER_STACK] / statements,
+                    (double)counts[i][TIER_REGISTER] / statements);
+        }
+        fprintf(report, "\n");
+    }
+    fclose(report);
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Table microbenchmark: insert, lookup hit, lookup miss and delete over
+// interned keys, reported as nanoseconds per operation.
+//
+// Usage: table_bench [keys]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "table.h"
+#include "intern.h"
+
+#define DEFAULT_KEYS 1000000
+#define ROUNDS 5
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static const char** make_keys(Interner* strings, const char* prefix, int count) {
+    const char** keys = (const char**)malloc(count * sizeof(const char*));
+    if (!keys) exit(1);
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        int length = snprintf(name, sizeof(name), "%s%d", prefix, i);
+        keys[i] = intern(strings, name, length);
+    }
+    return keys;
+}
+
+// Lookups visit keys in a different order than they were inserted
+static void shuffle(const char** keys, int count) {
+    srand(42);
+    for (int i = count - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        const char* key = keys[i];
+        keys[i] = keys[j];
+        keys[j] = key;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS;
+    Interner strings;
+    init_interner(&strings);
+    const char** hits = make_keys(&strings, "name", count);
+    const char** misses = make_keys(&strings, "missing", count);
+
+    double insert = 0, hit = 0, miss = 0, delete = 0;
+    long found = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        Table table;
+        initTable(&table);
+        Value value;
+
+        double start = now_ns();
+        for (int i = 0; i < count; i++) {
+            tableSet(&table, hits[i], NUMBER_VAL(i));
+        }
+        insert += now_ns() - start;
+
+        shuffle(hits, count);
+        start = now_ns();
+        for (int i = 0; i < count; i++) {
+            found += tableGet(&table, hits[i], &value);
+        }
+        hit += now_ns() - start;
+
+        start = now_ns();
+        for (int i = 0; i < count; i++) {
+            found += tableGet(&table, misses[i], &value);
+        }
+        miss += now_ns() - start;
+
+        start = now_ns();
+        for (int i = 0; i < count; i++) {
+            found += tableDelete(&table, hits[i]);
+        }
+        delete += now_ns() - start;
+        freeTable(&table);
+    }
+
+    double operations = (double)count * ROUNDS;
+    printf("%d keys, %d rounds (%ld found)\n", count, ROUNDS, found);
+    printf("insert:      %6.1f ns/op\n", insert / operations);
+    printf("lookup hit:  %6.1f ns/op\n", hit / operations);
+    printf("lookup miss: %6.1f ns/op\n", miss / operations);
+    printf("delete:      %6.1f ns/op\n", delete / operations);
+
+    free(hits);
+    free(misses);
+    free_interner(&strings);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for data that is freed all at once (e.g. an AST).
+// Allocations are carved out of large blocks; there is no per-allocation
+// free, and free_arena releases every block in one go.
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+    _Alignas(16) unsigned char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;        // Block currently being filled
+    size_t block_size;
+    size_t total;            // Bytes handed out, for diagnostics
+} Arena;
+
+Arena* create_arena(size_t block_size);
+void free_arena(Arena* arena);
+
+// Allocate size bytes aligned to 16; the memory is not zeroed
+void* arena_alloc(Arena* arena, size_t size);
+
+// Move every block of other into arena and free other; memory handed out
+// by other stays valid and is now released with arena
+void arena_adopt(Arena* arena, Arena* other);
+
+#endif // ARENA_H
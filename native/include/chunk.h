@@ -0,0 +1,85 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdio.h>
+#include "value.h"
+
+// Bytecode instructions
+// Operands are one byte unless noted; constant indices are 16-bit and
+// global slots 24-bit, high byte first.
+typedef enum {
+    OP_CONSTANT,             // [index16] push constant
+    OP_NULL,
+    OP_TRUE,
+    OP_FALSE,
+    OP_POP,
+    OP_GET_GLOBAL,           // [slot24] push global, null if undefined
+    OP_DEFINE_GLOBAL,        // [slot24] bind global to the popped value
+    OP_EQUAL,
+    OP_GREATER,
+    OP_LESS,
+    OP_GREATER_EQUAL,
+    OP_LESS_EQUAL,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_NOT,
+    OP_NEGATE,
+    OP_PRINT,                // Print the popped value as a text statement
+    OP_INPUT,                // [prompt16] read a line and push it
+    OP_TO_NUMBER,
+    OP_GAME_ENGINE,
+    OP_ANIMATE,              // Render the popped animation
+    OP_CALL,                 // Call the popped value if it is a function
+    OP_TAIL_CALL,            // OP_CALL in the caller's frame; always followed by OP_RETURN
+    OP_RETURN,
+
+    // Superinstructions, fused by the compiler's peephole pass from the
+    // most frequent pairs in opcode profiles (make profile)
+    OP_CALL_GLOBAL,          // [slot24] OP_GET_GLOBAL + OP_CALL
+    OP_TAIL_CALL_GLOBAL,     // [slot24] OP_GET_GLOBAL + OP_TAIL_CALL
+    OP_PRINT_CONSTANT,       // [index16] OP_CONSTANT + OP_PRINT
+    OP_ADD_CONSTANT,         // [index16] OP_CONSTANT + OP_ADD
+    OP_SUBTRACT_CONSTANT,    // [index16] OP_CONSTANT + OP_SUBTRACT
+    OP_MULTIPLY_CONSTANT,    // [index16] OP_CONSTANT + OP_MULTIPLY
+    OP_DIVIDE_CONSTANT       // [index16] OP_CONSTANT + OP_DIVIDE
+} OpCode;
+
+// Chunk of bytecode
+typedef struct {
+    int count;
+    int capacity;
+    uint8_t* code;
+    int* lines;
+    ValueArray constants;
+    int max_stack;           // Deepest the operand stack gets; set by the compiler
+} Chunk;
+
+void init_chunk(Chunk* chunk);
+void free_chunk(Chunk* chunk);
+void chunk_write(Chunk* chunk, uint8_t byte, int line);
+
+// Add value to the constant pool and return its index
+int chunk_add_constant(Chunk* chunk, Value value);
+
+// Serialize a chunk (and the chunks of its function constants) to out.
+// globals names the slots that OP_GET_GLOBAL and OP_DEFINE_GLOBAL refer to.
+void write_chunk(FILE* out, const Chunk* chunk, const char** globals, int global_count);
+
+// Name of an opcode, or NULL if op is not one
+const char* opcode_name(uint8_t op);
+
+// Size in bytes of an instruction with opcode op, operands included
+int instruction_length(uint8_t op);
+
+// Net number of values an instruction with opcode op pushes (negative if
+// it pops more than it pushes). Calls and returns count only the operands
+// of the calling frame.
+int stack_effect(uint8_t op);
+
+// Debug output; globals may be NULL, in which case slots print as numbers
+void disassemble_chunk(const Chunk* chunk, const char* name, const char** globals);
+int disassemble_instruction(const Chunk* chunk, int offset, const char** globals);
+
+#endif // CHUNK_H
@@ -0,0 +1,36 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "vm.h"
+
+// AST to bytecode compiler.
+// Statements are compiled one at a time into chunk, so a caller can run
+// each top-level statement as soon as it is parsed. Function definitions
+// become ObjFunction constants; in lazy mode their bodies are compiled by
+// compile_function on first call.
+typedef struct {
+    VM* vm;
+    Chunk* chunk;
+    bool lazy;               // Defer function bodies until first call
+    bool had_error;
+    Table string_constants;  // Interned handle -> constant index in chunk
+    int last_call;           // Offset of the latest OP_CALL, or -1
+} Compiler;
+
+void init_compiler(Compiler* compiler, VM* vm, Chunk* chunk, bool lazy);
+void free_compiler(Compiler* compiler);
+void compile_statement(Compiler* compiler, ASTNode* statement);
+
+// End the chunk with OP_RETURN, run the peephole pass over it and record
+// its max_stack. A call right before the return becomes OP_TAIL_CALL, which
+// reuses the caller's frame.
+void emit_return(Compiler* compiler, int line);
+
+// Compile every statement of a NODE_PROGRAM, then OP_RETURN
+bool compile_program(Compiler* compiler, ASTNode* program);
+
+// Compile a function's body into function->chunk (parsing it first if the
+// parser skipped it). Returns false on a syntax or compile error.
+bool compile_function(VM* vm, ObjFunction* function, bool lazy);
+
+#endif // COMPILER_H
@@ -0,0 +1,87 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include "parser.h"
+#include <stdint.h>
+
+// Flat AST layout.
+// All nodes live in one contiguous array and refer to their children by
+// 32-bit index. The direct children of a list (program statements, game
+// engine animations) are stored next to each other, so a list is just a
+// [first, first + count) range that can be walked linearly.
+typedef uint32_t NodeIndex;
+
+#define NO_NODE UINT32_MAX
+
+typedef struct {
+    NodeType type;
+    int line;                // Source line, for diagnostics
+    union {
+        struct {
+            NodeIndex first;         // First statement
+            int count;
+        } program;
+        struct {
+            const char* name;
+            NodeIndex body;
+        } function_definition;
+        struct {
+            const char* content;
+            NodeIndex expr;
+        } text;
+        struct {
+            const char* value;
+        } string_literal;
+        struct {
+            double value;
+        } number;
+        struct {
+            const char* name;
+        } identifier;
+        struct {
+            const char* prompt;
+        } input;
+        struct {
+            NodeIndex expr;
+        } number_conversion;
+        struct {
+            NodeIndex expr;
+            NodeIndex first_animation;
+            int animation_count;
+        } game_engine;
+        struct {
+            const char* emoji;
+            const char* action;
+            int distance;
+            int repeat;
+            int speed;
+        } animation;
+        struct {
+            bool value;
+        } boolean;
+        struct {
+            TokenType op;
+            NodeIndex operand;
+        } unary;
+        struct {
+            TokenType op;
+            NodeIndex left;
+            NodeIndex right;
+        } binary;
+    } data;
+} FlatNode;
+
+typedef struct {
+    FlatNode* nodes;
+    int count;
+    int capacity;
+    NodeIndex root;
+} FlatAST;
+
+// Build a flat copy of a pointer-based tree (strings stay interned handles).
+// Function bodies skipped by a lazy parser are parsed first.
+FlatAST* flatten_ast(ASTNode* root);
+void free_flat_ast(FlatAST* ast);
+void print_flat_ast(const FlatAST* ast, NodeIndex index, int depth);
+
+#endif // FLAT_AST_H
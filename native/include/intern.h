@@ -0,0 +1,52 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Interned string storage.
+// Every distinct string is stored once, and the handle returned by intern()
+// is a canonical NUL-terminated pointer, so two interned names are equal
+// exactly when their pointers are. The hash and length live in a header in
+// front of the characters and can be read back without rehashing.
+typedef struct {
+    uint32_t hash;
+    uint32_t length;
+    char chars[];
+} InternedString;
+
+typedef struct {
+    InternedString** entries;
+    int count;
+    int capacity;
+    pthread_mutex_t* lock;   // Set while the interner is shared between threads
+} Interner;
+
+void init_interner(Interner* interner);
+void free_interner(Interner* interner);
+
+// Return the canonical copy of chars[0, length), adding it if needed
+const char* intern(Interner* interner, const char* chars, size_t length);
+
+// Return the canonical copy if it exists, NULL otherwise
+const char* intern_find(const Interner* interner, const char* chars, size_t length);
+
+// Hash used for interned strings (FNV-1a)
+uint32_t hash_string(const char* chars, size_t length);
+
+// Header of an interned handle
+static inline const InternedString* interned_header(const char* handle) {
+    return (const InternedString*)(handle - offsetof(InternedString, chars));
+}
+
+static inline uint32_t interned_hash(const char* handle) {
+    return interned_header(handle)->hash;
+}
+
+static inline uint32_t interned_length(const char* handle) {
+    return interned_header(handle)->length;
+}
+
+#endif // INTERN_H
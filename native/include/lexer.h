@@ -5,6 +5,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "thread_pool.h"
+#include "intern.h"
 
 // Token types
 typedef enum {
@@ -41,6 +45,7 @@ typedef enum {
     TOKEN_GT,
     TOKEN_LTE,
     TOKEN_GTE,
+    TOKEN_BANG,
     
     // Delimiters
     TOKEN_LPAREN,
@@ -69,31 +74,71 @@ typedef enum {
 } TokenType;
 
 // Token structure
+// A token is a view into the lexer's source buffer; nothing is copied while
+// lexing. For string literals the span covers the text between the quotes.
 typedef struct {
     TokenType type;
-    union {
-        char* string_val;    // For identifiers and string literals
-        double number_val;   // For numeric literals
-    } value;
+    size_t offset;           // Absolute start of the lexeme in the source
+    int length;              // Length of the lexeme in bytes
     int line;
     int column;
 } Token;
 
 typedef struct {
     const char* source;
-    int position;
+    size_t length;           // Cached strlen(source)
+    size_t base;             // Absolute offset of source[0] (non-zero when streaming)
+    size_t position;
     int line;
     int column;
+    const char* error;       // Message for the last TOKEN_ERROR, if any
     Token current;
 } Lexer;
 
+// Whole-source token buffer in structure-of-arrays layout.
+// Produced in one lexing pass by tokenize(); always ends with a TOKEN_EOF or
+// TOKEN_ERROR entry, so index count - 1 is a valid place to stop.
+typedef struct {
+    uint8_t* types;
+    size_t* offsets;
+    uint32_t* lengths;
+    uint32_t* lines;
+    uint32_t* columns;
+    int count;
+    int capacity;
+} TokenBuffer;
+
+// tokenize_parallel gives each chunk at least this much source, so
+// anything shorter than two chunks is lexed serially
+#define PARALLEL_LEX_MIN_CHUNK (256 * 1024)
+#define PARALLEL_LEX_MIN_SOURCE (2 * PARALLEL_LEX_MIN_CHUNK)
+
 // Function declarations
 Lexer* create_lexer(const char* source);
+Lexer* create_lexer_with_length(const char* source, size_t length);
+void init_lexer(Lexer* lexer, const char* source, size_t length);
 Token get_next_token(Lexer* lexer);
 void free_lexer(Lexer* lexer);
 
+// Token buffer operations
+TokenBuffer* tokenize(Lexer* lexer);
+TokenBuffer* tokenize_parallel(const char* source, size_t length, ThreadPool* pool);
+void token_buffer_push(TokenBuffer* buffer, Token token);
+Token token_at(const TokenBuffer* buffer, int index);
+void free_token_buffer(TokenBuffer* buffer);
+
+// Keyword lookup, shared by the lexer and parser
+TokenType lookup_keyword(const char* start, int length);
+
+// Token accessors
+const char* token_start(const Lexer* lexer, const Token* token);
+char* token_string(const Lexer* lexer, const Token* token);
+const char* token_intern(const Lexer* lexer, const Token* token, Interner* strings);
+double token_number(const Lexer* lexer, const Token* token);
+bool token_equals(const Lexer* lexer, const Token* token, const char* text);
+
 // Helper function declarations
-static Token make_token(TokenType type, const char* value, Lexer* lexer);
+static Token make_token(TokenType type, size_t start, int line, int column, Lexer* lexer);
 static void advance(Lexer* lexer);
 static char current_char(Lexer* lexer);
 static char peek_char(Lexer* lexer);
@@ -0,0 +1,17 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stddef.h>
+
+// Decimal number parsing shared by the lexer and the VM.
+// The literal grammar is: digits [ '.' [digits] ] [ ('e' | 'E') [sign] digits ]
+
+// Length of the numeric literal at the start of str[0, length), 0 if none
+size_t scan_number(const char* str, size_t length);
+
+// Parse an optionally signed literal at the start of str[0, length) into a
+// correctly rounded double. Returns the number of bytes consumed, or 0 (with
+// *value set to 0) if str does not start with a number.
+size_t parse_double(const char* str, size_t length, double* value);
+
+#endif // NUMBER_H
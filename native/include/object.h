@@ -0,0 +1,60 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "chunk.h"
+#include "register_chunk.h"
+#include "parser.h"
+
+// Heap objects owned by the VM, chained through next and freed together
+typedef enum {
+    OBJ_FUNCTION,
+    OBJ_ANIMATION
+} ObjType;
+
+struct Obj {
+    ObjType type;
+    struct Obj* next;
+};
+
+// A compiled function. The body is compiled from its definition the first
+// time the function is called, so chunk is NULL until then. Functions
+// compiled for the register tier carry registers instead.
+typedef struct {
+    Obj obj;
+    const char* name;        // Interned
+    ASTNode* definition;     // NODE_FUNCTION_DEFINITION in a tree the VM keeps
+    Chunk* chunk;
+    RegisterChunk* registers;
+} ObjFunction;
+
+// An animation record; emoji and action are interned
+typedef struct {
+    Obj obj;
+    const char* emoji;
+    const char* action;
+    int distance;
+    int repeat;
+    int speed;
+} ObjAnimation;
+
+static inline bool is_obj_type(Value value, ObjType type) {
+    return IS_OBJ(value) && AS_OBJ(value)->type == type;
+}
+
+#define IS_FUNCTION(value) is_obj_type(value, OBJ_FUNCTION)
+#define IS_ANIMATION(value) is_obj_type(value, OBJ_ANIMATION)
+#define AS_FUNCTION(value) ((ObjFunction*)AS_OBJ(value))
+#define AS_ANIMATION(value) ((ObjAnimation*)AS_OBJ(value))
+
+static inline ValueType value_type(Value value) {
+    if (IS_NUMBER(value)) return VAL_NUMBER;
+    if (IS_STRING(value)) return VAL_STRING;
+    if (IS_BOOL(value)) return VAL_BOOLEAN;
+    if (IS_DEFINITION(value)) return VAL_FUNCTION;
+    if (IS_OBJ(value)) {
+        return AS_OBJ(value)->type == OBJ_FUNCTION ? VAL_FUNCTION : VAL_ANIMATION;
+    }
+    return VAL_NULL;
+}
+
+#endif // OBJECT_H
@@ -0,0 +1,41 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Default size of a VM's output buffer
+#ifndef OUTPUT_BUFFER_SIZE
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+#endif
+
+// Buffered script output written straight to a file descriptor.
+// Text collects in data and goes out in one write when the buffer fills,
+// at every newline when fd is a terminal, and on flush_output. A capacity
+// of 0 writes every line through.
+typedef struct {
+    int fd;
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool line_buffered;      // Flush after each line (fd is a terminal)
+} Output;
+
+void init_output(Output* output, int fd, size_t capacity);
+
+// Flush, then release the buffer
+void free_output(Output* output);
+
+// Flush and switch to a buffer of capacity bytes
+void set_output_buffer_size(Output* output, size_t capacity);
+
+void output_write(Output* output, const char* data, size_t length);
+
+// Write data followed by a newline
+void output_line(Output* output, const char* data, size_t length);
+
+// Write out everything buffered. Returns false if the write failed, in
+// which case the buffered text is dropped.
+bool flush_output(Output* output);
+
+#endif // OUTPUT_H
@@ -2,6 +2,7 @@
 #define PARSER_H
 
 #include "lexer.h"
+#include "arena.h"
 
 // Node types
 typedef enum {
@@ -16,36 +17,59 @@ typedef enum {
     NODE_GAME_ENGINE,
     NODE_EXPRESSION,
     NODE_ANIMATION,
-    NODE_ANIMATION_LIST
+    NODE_ANIMATION_LIST,
+    NODE_BOOLEAN,
+    NODE_UNARY,
+    NODE_BINARY
 } NodeType;
 
+// Unparsed function body recorded by a lazy parser.
+// The text is a view into the original source, which must outlive the tree
+// while any body is still pending; nodes parsed later go into the tree's
+// arena and intern their strings into the same Interner.
+typedef struct {
+    const char* source;      // First byte after the opening brace
+    size_t length;           // Up to (not including) the closing brace
+    int line;
+    int column;
+    Arena* arena;
+    Interner* strings;
+} LazyBody;
+
 // AST node structures
+// Names and string literals are interned handles owned by the parser's
+// Interner (normally the VM's), so they are never freed with the tree.
 typedef struct ASTNode {
     NodeType type;
+    int line;                // Source line, for diagnostics
     union {
         struct {
             struct ASTNode** statements;
             int statement_count;
+            Arena* arena;            // Set on the root only
         } program;
         struct {
-            char* name;
-            struct ASTNode* body;
+            const char* name;
+            struct ASTNode* body;    // NULL while lazy is pending
+            LazyBody* lazy;          // Set by lazy parsers only
+            int slot;                // Global slot, set by the resolver
         } function_definition;
         struct {
-            char* content;
+            const char* content;
             struct ASTNode* expr;
         } text;
         struct {
-            char* value;
+            const char* value;
         } string_literal;
         struct {
             double value;
         } number;
         struct {
-            char* name;
+            const char* name;
+            int slot;                // Global slot, set by the resolver
         } identifier;
         struct {
-            char* prompt;
+            const char* prompt;
         } input;
         struct {
             struct ASTNode* expr;
@@ -56,29 +80,67 @@ typedef struct ASTNode {
             struct ASTNode* expr;
         } game_engine;
         struct {
-            char* emoji;
-            char* action;
+            const char* emoji;
+            const char* action;
             int distance;
             int repeat;
             int speed;
         } animation;
+        struct {
+            bool value;
+        } boolean;
+        struct {
+            TokenType op;            // TOKEN_MINUS or TOKEN_BANG
+            struct ASTNode* operand;
+        } unary;
+        struct {
+            TokenType op;
+            struct ASTNode* left;
+            struct ASTNode* right;
+        } binary;
     } data;
 } ASTNode;
 
 // Parser structure
+// In buffered mode the whole source is lexed up front into tokens and the
+// parser walks it by index; otherwise tokens are pulled from the lexer one
+// at a time.
 typedef struct {
     Lexer* lexer;
+    Interner* strings;       // Where names and literals are interned
     Token current;
     int had_error;
+    TokenBuffer* tokens;     // NULL in streaming mode
+    int token_index;         // Index of current in tokens
+    Arena* arena;            // Arena for the tree being parsed
+    struct ASTNode** scratch; // Lists under construction
+    int scratch_count;
+    int scratch_capacity;
+    bool lazy_functions;     // Skip function bodies until first call
+    ThreadPool* pool;        // Parse top-level functions on this pool (buffered mode)
+    FILE* errors;            // Where syntax errors are reported (stderr)
 } Parser;
 
 // Function declarations
-Parser* create_parser(Lexer* lexer);
+Parser* create_parser(Lexer* lexer, Interner* strings);
+Parser* create_buffered_parser(Lexer* lexer, Interner* strings);
+Parser* create_parser_from_tokens(Lexer* lexer, TokenBuffer* tokens, Interner* strings);
 void free_parser(Parser* parser);
 ASTNode* parse_program(Parser* parser);
+
+// Called with each top-level statement as soon as it has been parsed
+typedef void (*StatementHandler)(ASTNode* statement, void* arg);
+ASTNode* parse_program_streaming(Parser* parser, StatementHandler handler, void* arg);
 void free_ast(ASTNode* node);
+
+// Body of a function definition, parsing it first if it was skipped by a
+// lazy parser. Returns NULL if the body has a syntax error.
+ASTNode* parse_function_body(ASTNode* function);
 void print_ast(ASTNode* node, int depth);
 
+// Source spelling of a unary or binary operator token
+const char* operator_name(TokenType op);
+
 // Helper function declarations
 static void parser_advance(Parser* parser);
 static void expect(Parser* parser, TokenType type);
@@ -0,0 +1,81 @@
+#ifndef REGISTER_CHUNK_H
+#define REGISTER_CHUNK_H
+
+#include <stdio.h>
+#include "value.h"
+
+// Register tier instructions.
+// Each instruction is one 32-bit word in one of three layouts:
+//   ABC  op:8 A:8 B:8 C:8 (AC leaves B zero)
+//   ABx  op:8 A:8 Bx:16
+//   Sx   op:8 Sx:24
+// A is a destination register. B and C are RK operands: below RK_CONSTANT
+// they name a register, from RK_CONSTANT up the constant B - RK_CONSTANT.
+// Operators work in place: A is also their left or only operand, so its
+// handler neither tests the operand's kind nor releases what it replaces.
+// Instructions that need both an operand and a 24-bit global slot take
+// the slot from the word that follows them.
+typedef enum {
+    ROP_LOAD_CONSTANT,       // ABx  R[A] = K[Bx]
+    ROP_GET_GLOBAL,          // A, slot  R[A] = global, null if undefined
+    ROP_DEFINE_GLOBAL,       // B, slot  bind global to RK[B]
+    ROP_EQUAL,               // AC   R[A] = R[A] == RK[C]
+    ROP_NOT_EQUAL,
+    ROP_GREATER,
+    ROP_LESS,
+    ROP_GREATER_EQUAL,
+    ROP_LESS_EQUAL,
+    ROP_ADD,                 // AC   R[A] = R[A] + RK[C]
+    ROP_SUBTRACT,
+    ROP_MULTIPLY,
+    ROP_DIVIDE,
+    ROP_NOT,                 // A    R[A] = !R[A]
+    ROP_NEGATE,
+    ROP_TO_NUMBER,
+    ROP_INPUT,               // ABx  R[A] = a line read after printing K[Bx]
+    ROP_PRINT,               // B    print RK[B] as a text statement
+    ROP_GAME_ENGINE,
+    ROP_ANIMATE,             // B    render the animation RK[B]
+    ROP_CALL_GLOBAL,         // Sx   call global Sx if it is a function
+    ROP_TAIL_CALL_GLOBAL,    // Sx   the same in the caller's frame; followed by ROP_RETURN
+    ROP_RETURN
+} RegisterOpCode;
+
+#define RK_CONSTANT 128
+#define MAX_REGISTERS RK_CONSTANT
+
+#define ENCODE_ABC(op, a, b, c) \
+    ((uint32_t)(op) | (uint32_t)(a) << 8 | (uint32_t)(b) << 16 | (uint32_t)(c) << 24)
+#define ENCODE_ABX(op, a, bx) ((uint32_t)(op) | (uint32_t)(a) << 8 | (uint32_t)(bx) << 16)
+#define ENCODE_SX(op, sx) ((uint32_t)(op) | (uint32_t)(sx) << 8)
+
+#define DECODE_OP(word) ((word) & 0xff)
+#define DECODE_A(word) (((word) >> 8) & 0xff)
+#define DECODE_B(word) (((word) >> 16) & 0xff)
+#define DECODE_C(word) ((word) >> 24)
+#define DECODE_BX(word) ((word) >> 16)
+#define DECODE_SX(word) ((word) >> 8)
+
+// Register tier counterpart of Chunk. register_count is the size of the
+// register window the code needs.
+typedef struct {
+    int count;
+    int capacity;
+    uint32_t* code;
+    int* lines;
+    ValueArray constants;
+    int register_count;
+} RegisterChunk;
+
+void init_register_chunk(RegisterChunk* chunk);
+void free_register_chunk(RegisterChunk* chunk);
+void register_chunk_write(RegisterChunk* chunk, uint32_t word, int line);
+
+// Add value to the constant pool and return its index
+int register_chunk_add_constant(RegisterChunk* chunk, Value value);
+
+// Debug output, with compiled function bodies after their parent; globals
+// may be NULL, in which case slots print as numbers
+void disassemble_register_chunk(const RegisterChunk* chunk, const char* name, const char** globals);
+
+#endif // REGISTER_CHUNK_H
@@ -0,0 +1,36 @@
+#ifndef REGISTER_COMPILER_H
+#define REGISTER_COMPILER_H
+
+#include "vm.h"
+#include "register_chunk.h"
+
+// AST to register code compiler, the register tier's counterpart of
+// Compiler. Expressions are compiled into a destination register; their
+// temporaries are allocated above it and freed again at the end of each
+// statement, so no register is live across a statement. An operator
+// works in place on its left operand's register; small constants on the
+// right are used as RK operands instead of being loaded.
+typedef struct {
+    VM* vm;
+    RegisterChunk* chunk;
+    bool lazy;               // Defer function bodies until first call
+    bool had_error;
+    int next_register;       // First free register in the current statement
+    int last_call;           // Offset of the latest ROP_CALL_GLOBAL, or -1
+} RegisterCompiler;
+
+void init_register_compiler(RegisterCompiler* compiler, VM* vm, RegisterChunk* chunk, bool lazy);
+void compile_register_statement(RegisterCompiler* compiler, ASTNode* statement);
+
+// End the chunk with ROP_RETURN; a call right before it becomes
+// ROP_TAIL_CALL_GLOBAL
+void emit_register_return(RegisterCompiler* compiler, int line);
+
+// Compile every statement of a NODE_PROGRAM, then ROP_RETURN
+bool compile_register_program(RegisterCompiler* compiler, ASTNode* program);
+
+// Compile a function's body into function->registers (parsing it first if
+// the parser skipped it). Returns false on a syntax or compile error.
+bool compile_register_function(VM* vm, ObjFunction* function, bool lazy);
+
+#endif // REGISTER_COMPILER_H
@@ -0,0 +1,26 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "vm.h"
+
+// Name resolution.
+// Every distinct global name gets a fixed slot in vm->symbols the first
+// time it is seen, and identifier and function definition nodes remember
+// their slot, so runtime lookups are an array index. ibery++ has no local
+// bindings; functions defined inside a body are global too.
+
+#define UNRESOLVED_SLOT -1
+
+// Slot for name, assigning the next free one on first use. Names are
+// interned handles.
+int resolve_global(VM* vm, const char* name);
+
+// Bind every identifier and function definition under node to its slot.
+// Bodies a lazy parser skipped are resolved when they are parsed.
+void resolve_ast(VM* vm, ASTNode* node);
+
+// Slot of an identifier or function definition, resolving it now if no
+// pass has reached it yet
+int node_slot(VM* vm, ASTNode* node);
+
+#endif // RESOLVER_H
@@ -0,0 +1,27 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+// Character-class scanners used by the lexer.
+// Each scanner looks at src[pos, end) and returns the index of the first byte
+// that does not belong to its class, or end if every byte does. The SIMD
+// kernel (AVX2, SSE2 or scalar) is picked once at runtime from the CPU.
+
+// Skip ' ', '\t', '\n', '\v', '\f' and '\r'
+size_t scan_whitespace(const char* src, size_t pos, size_t end);
+
+// Skip [A-Za-z0-9_]
+size_t scan_identifier(const char* src, size_t pos, size_t end);
+
+// Skip a string body, stopping at '"' or '\0'
+size_t scan_string_body(const char* src, size_t pos, size_t end);
+
+// Count '\n' in src[pos, end); *last_newline gets the index of the last one
+// found and is left untouched if there are none
+int scan_count_newlines(const char* src, size_t pos, size_t end, size_t* last_newline);
+
+// Name of the selected kernel ("avx2", "sse2" or "scalar")
+const char* scan_backend(void);
+
+#endif // SCAN_H
@@ -0,0 +1,42 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include "lexer.h"
+
+// Default window for streaming lexing
+#define SOURCE_WINDOW_SIZE (64 * 1024 * 1024)
+
+// A whole source file, memory-mapped where possible.
+// data is always NUL-terminated so it can be handed to code that expects
+// a C string.
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t mapping_size;     // Size of the mapping, 0 if data is heap memory
+} Source;
+
+// A source file lexed through a sliding mapped window.
+// Only window_size bytes (plus the token in progress) are mapped at once, so
+// resident memory stays bounded no matter how large the file is. Tokens
+// returned by source_stream_next can be materialized with
+// token_string(&stream->lexer, ...) until the next call.
+typedef struct {
+    int fd;
+    size_t file_size;
+    size_t window_size;
+    size_t window_offset;    // File offset of the mapped window
+    size_t window_length;    // Bytes of the file inside the window
+    char* window;
+    Lexer lexer;
+} SourceStream;
+
+// Whole-file loading
+bool load_source(const char* filename, Source* source);
+void release_source(Source* source);
+
+// Streaming
+bool open_source_stream(const char* filename, size_t window_size, SourceStream* stream);
+Token source_stream_next(SourceStream* stream);
+void close_source_stream(SourceStream* stream);
+
+#endif // SOURCE_H
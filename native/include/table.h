@@ -0,0 +1,39 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "value.h"
+
+// Hash table keyed by interned strings.
+// Keys are canonical handles from an Interner, so lookups compare pointers
+// and reuse the hash stored in front of the key.
+//
+// Slots are open addressed in groups of TABLE_GROUP_SIZE, SwissTable
+// style: each slot has a control byte holding 7 bits of the key's hash, or
+// marking it empty or deleted, and a whole group's control bytes are
+// matched at once before any key is touched.
+#define TABLE_GROUP_SIZE 16
+
+// A key and its value share a slot, so a hit touches one line past the
+// control bytes
+typedef struct {
+    const char* key;
+    Value value;
+} Entry;
+
+typedef struct {
+    int count;               // Live entries
+    int tombstones;          // Deleted slots not yet reclaimed
+    int capacity;            // Slots; 0 or a power of two >= TABLE_GROUP_SIZE
+    uint8_t* control;
+    Entry* entries;
+} Table;
+
+void initTable(Table* table);
+void freeTable(Table* table);
+
+// Returns true if key was not in the table before
+bool tableSet(Table* table, const char* key, Value value);
+bool tableGet(const Table* table, const char* key, Value* value);
+bool tableDelete(Table* table, const char* key);
+
+#endif // TABLE_H
@@ -0,0 +1,22 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Fixed-size worker pool used by the parallel front-end passes
+
+typedef void (*ThreadTask)(void* arg);
+
+typedef struct ThreadPool ThreadPool;
+
+// Create a pool with thread_count workers (0 = one per online CPU)
+ThreadPool* create_thread_pool(int thread_count);
+void free_thread_pool(ThreadPool* pool);
+
+int thread_pool_size(const ThreadPool* pool);
+
+// Queue task(arg) to run on a worker
+void thread_pool_submit(ThreadPool* pool, ThreadTask task, void* arg);
+
+// Block until every submitted task has finished
+void thread_pool_wait(ThreadPool* pool);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,133 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Obj Obj;
+
+// Values are NaN-boxed into 64 bits. A double that is not one of the quiet
+// NaNs below is a number. The rest carry a payload:
+//   sign clear: null, false or true in the low bits
+//   sign set:   a 48-bit pointer, with its kind in bits 48-49
+// Anything larger than a word (animations, functions) lives behind an Obj.
+typedef uint64_t Value;
+
+// Coarse type of a value, for code that switches on it
+typedef enum {
+    VAL_NUMBER,
+    VAL_STRING,
+    VAL_BOOLEAN,
+    VAL_NULL,
+    VAL_FUNCTION,
+    VAL_ANIMATION
+} ValueType;
+
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN ((uint64_t)0x7ffc000000000000)
+
+#define TAG_NULL 1
+#define TAG_FALSE 2
+#define TAG_TRUE 3
+
+// Pointer kinds. Both string kinds have bit 48 set.
+#define POINTER_OBJECT ((uint64_t)0 << 48)         // Obj*
+#define POINTER_STRING ((uint64_t)1 << 48)         // Interned char*, lives as long as the VM
+#define POINTER_DEFINITION ((uint64_t)2 << 48)     // Function syntax tree, for the tree walkers
+#define POINTER_SHARED_STRING ((uint64_t)3 << 48)  // SharedString chars, reference counted
+#define POINTER_MASK (SIGN_BIT | QNAN | ((uint64_t)3 << 48))
+#define PAYLOAD_MASK (((uint64_t)1 << 48) - 1)
+
+#define NULL_VAL ((Value)(QNAN | TAG_NULL))
+#define FALSE_VAL ((Value)(QNAN | TAG_FALSE))
+#define TRUE_VAL ((Value)(QNAN | TAG_TRUE))
+#define BOOL_VAL(b) ((b) ? TRUE_VAL : FALSE_VAL)
+#define STRING_VAL(chars) ((Value)(SIGN_BIT | QNAN | POINTER_STRING | (uint64_t)(uintptr_t)(chars)))
+#define OBJ_VAL(object) ((Value)(SIGN_BIT | QNAN | POINTER_OBJECT | (uint64_t)(uintptr_t)(object)))
+#define DEFINITION_VAL(node) ((Value)(SIGN_BIT | QNAN | POINTER_DEFINITION | (uint64_t)(uintptr_t)(node)))
+// A definition is an ASTNode*, or a FlatNode* for the flat walker with the
+// low payload bit set (both are 8-byte aligned)
+#define FLAT_DEFINITION_BIT ((uint64_t)1)
+#define FLAT_DEFINITION_VAL(node) (DEFINITION_VAL(node) | FLAT_DEFINITION_BIT)
+#define SHARED_STRING_VAL(chars) ((Value)(SIGN_BIT | QNAN | POINTER_SHARED_STRING | (uint64_t)(uintptr_t)(chars)))
+
+#define IS_NUMBER(value) (((value) & QNAN) != QNAN)
+#define IS_NULL(value) ((value) == NULL_VAL)
+#define IS_BOOL(value) (((value) | 1) == TRUE_VAL)
+#define IS_STRING(value) (((value) & (SIGN_BIT | QNAN | POINTER_STRING)) == (SIGN_BIT | QNAN | POINTER_STRING))
+#define IS_SHARED_STRING(value) (((value) & POINTER_MASK) == (SIGN_BIT | QNAN | POINTER_SHARED_STRING))
+#define IS_OBJ(value) (((value) & POINTER_MASK) == (SIGN_BIT | QNAN | POINTER_OBJECT))
+#define IS_DEFINITION(value) (((value) & POINTER_MASK) == (SIGN_BIT | QNAN | POINTER_DEFINITION))
+#define IS_TREE_DEFINITION(value) (IS_DEFINITION(value) && !((value) & FLAT_DEFINITION_BIT))
+#define IS_FLAT_DEFINITION(value) (IS_DEFINITION(value) && ((value) & FLAT_DEFINITION_BIT))
+
+#define AS_BOOL(value) ((value) == TRUE_VAL)
+#define AS_STRING(value) ((char*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define AS_OBJ(value) ((Obj*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define AS_DEFINITION(value) ((void*)(uintptr_t)((value) & PAYLOAD_MASK & ~FLAT_DEFINITION_BIT))
+
+static inline double AS_NUMBER(Value value) {
+    double number;
+    memcpy(&number, &value, sizeof(number));
+    return number;
+}
+
+// Arithmetic only ever produces the hardware's default NaN, which is not
+// boxed; NaNs parsed from text must go through canonical_number
+static inline Value NUMBER_VAL(double number) {
+    Value value;
+    memcpy(&value, &number, sizeof(value));
+    return value;
+}
+
+static inline Value canonical_number(double number) {
+    return number != number ? NUMBER_VAL(__builtin_nan("")) : NUMBER_VAL(number);
+}
+
+// A string built at runtime (input, concatenation). Immutable, and freed
+// when the last value holding it is released. Literals are interned
+// instead and never counted. Like an interned string, the length sits in
+// the word before the characters.
+typedef struct {
+    uint32_t refs;
+    uint32_t length;
+    char chars[];
+} SharedString;
+
+static inline SharedString* shared_string_header(Value value) {
+    return (SharedString*)(AS_STRING(value) - offsetof(SharedString, chars));
+}
+
+// A value stored somewhere new must be retained, and released when that
+// place lets go of it. Only shared strings are counted.
+static inline void retain_value(Value value) {
+    if (IS_SHARED_STRING(value)) shared_string_header(value)->refs++;
+}
+
+static inline void release_value(Value value) {
+    if (IS_SHARED_STRING(value)) {
+        SharedString* string = shared_string_header(value);
+        if (--string->refs == 0) free(string);
+    }
+}
+
+// New shared string holding a copy of chars[0, length), with one reference
+Value new_string(const char* chars, size_t length);
+size_t string_length(Value string);
+Value concatenate_strings(Value a, Value b);
+
+// Value array structure
+typedef struct ValueArray {
+    int capacity;
+    int count;
+    Value* values;
+} ValueArray;
+
+void init_value_array(ValueArray* array);
+void free_value_array(ValueArray* array);
+void write_value_array(ValueArray* array, Value value);
+
+#endif // VALUE_H
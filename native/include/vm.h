@@ -2,103 +2,24 @@
 #define VM_H
 
 #include "parser.h"
+#include "flat_ast.h"
+#include "value.h"
+#include "chunk.h"
+#include "table.h"
+#include "object.h"
+#include "output.h"
 #include <stdbool.h>
 #include <stdint.h>
 
-#define STACK_MAX 256
+// Initial operand stack size in values; the stack grows as frames need it
+#ifndef STACK_INITIAL
+#define STACK_INITIAL 256
+#endif
 
-// Forward declarations
-typedef struct Obj Obj;
-typedef struct Table Table;
-typedef struct ValueArray ValueArray;
-
-// Table structure
-typedef struct {
-    int count;
-    int capacity;
-    char** keys;
-    Value* values;
-} Table;
-
-// Value array structure
-typedef struct ValueArray {
-    int capacity;
-    int count;
-    Value* values;
-} ValueArray;
-
-// Animation structure
-typedef struct {
-    char* emoji;
-    char* action;
-    int distance;
-    int repeat;
-    int speed;
-} Animation;
-
-// Value types
-typedef enum {
-    VAL_NUMBER,
-    VAL_STRING,
-    VAL_BOOLEAN,
-    VAL_NULL,
-    VAL_FUNCTION,
-    VAL_CLASS,
-    VAL_INSTANCE,
-    VAL_LIST,
-    VAL_MAP,
-    VAL_COMMAND,
-    VAL_INPUT,
-    VAL_ANIMATION,
-    VAL_OBJECT
-} ValueType;
-
-// Value representation
-typedef struct {
-    ValueType type;
-    union {
-        double number;
-        char* string;
-        bool boolean;
-        void* object;
-        void* function;
-        struct {
-            char* cmd;
-            char** args;
-            int arg_count;
-        } command;
-        Animation animation;
-    } as;
-} Value;
-
-// Bytecode instructions
-typedef enum {
-    OP_CONSTANT,
-    OP_NULL,
-    OP_TRUE,
-    OP_FALSE,
-    OP_POP,
-    OP_GET_LOCAL,
-    OP_SET_LOCAL,
-    OP_GET_GLOBAL,
-    OP_DEFINE_GLOBAL,
-    OP_SET_GLOBAL,
-    OP_EQUAL,
-    OP_GREATER,
-    OP_LESS,
-    OP_ADD,
-    OP_SUBTRACT,
-    OP_MULTIPLY,
-    OP_DIVIDE,
-    OP_NOT,
-    OP_NEGATE,
-    OP_PRINT,
-    OP_JUMP,
-    OP_JUMP_IF_FALSE,
-    OP_LOOP,
-    OP_CALL,
-    OP_RETURN
-} OpCode;
+// Default limit on nested calls; a VM's max_frames may be changed after initVM
+#ifndef CALL_DEPTH_MAX
+#define CALL_DEPTH_MAX 100000
+#endif
 
 // Code fix types
 typedef enum {
@@ -130,14 +51,22 @@ typedef enum {
     INTERPRET_RUNTIME_ERROR
 } InterpretResult;
 
-// Chunk of bytecode
+// An active function call. Bytecode and tree-walker calls share the frame
+// stack: the VM resumes a frame at ip in chunk, a register tier frame at pc
+// in registers, the tree walker at statement next of body, and the flat
+// walker at node next of the statement range [next, end). Tail calls
+// reuse the caller's frame.
 typedef struct {
-    int count;
-    int capacity;
-    uint8_t* code;
-    int* lines;
-    ValueArray constants;
-} Chunk;
+    ObjFunction* function;   // NULL for a script or a tree-walker frame
+    Chunk* chunk;
+    uint8_t* ip;             // Return address while a callee runs
+    RegisterChunk* registers;
+    uint32_t* pc;
+    Value* slots;            // Stack window base
+    ASTNode* body;           // NODE_PROGRAM being walked
+    int next;
+    int end;                 // Flat walker only
+} CallFrame;
 
 // Virtual Machine
 typedef struct {
@@ -146,14 +75,19 @@ typedef struct {
     int heap_size;
     int heap_capacity;
     
-    // Symbol table for variables
+    // Global slots (names are interned). The resolver assigns each name an
+    // index into names/values; slots maps a name to its index.
     struct {
-        char** names;
-        void** values;
+        const char** names;
+        Value* values;
         int count;
         int capacity;
+        Table slots;
     } symbols;
 
+    // Script output (text statements, prompts); buffered until a flush
+    Output output;
+
     // Terminal state
     struct {
         char* current_dir;
@@ -168,22 +102,45 @@ typedef struct {
         int fix_capacity;
     } fixer;
 
-    // Runtime state
-    Chunk* chunk;
-    uint8_t* ip;
-    Value stack[STACK_MAX];
+    // Bytecode state
+    Chunk* chunk;            // Output of compile()
+    RegisterChunk* register_chunk;  // Output of compile_registers()
+    Value* stack;            // Grown on frame entry to fit the frame's max_stack
     Value* stackTop;
-    Table globals;
-    Table strings;
+    Value* stackEnd;
+    CallFrame* frames;       // Grown on demand up to max_frames
+    int frame_count;
+    int frame_capacity;
+    int max_frames;
+    Interner strings;
     Obj* objects;
+
+    // Trees that function objects still point into; freed with the VM
+    ASTNode** programs;
+    int program_count;
+    int program_capacity;
 } VM;
 
-// Function declarations
+// Function declarations. A runtime error stops the program: the statement
+// returns false and the program non-zero.
 VM* create_vm();
 void free_vm(VM* vm);
 int execute_program(VM* vm, ASTNode* program);
 Value evaluate_expression(VM* vm, ASTNode* expr);
-void execute_statement(VM* vm, ASTNode* stmt);
+bool execute_statement(VM* vm, ASTNode* stmt);
+
+// Operator semantics
+bool is_truthy(Value value);
+void print_text_value(VM* vm, Value value);
+bool values_equal(Value a, Value b);
+Value apply_unary(VM* vm, TokenType op, Value operand);
+Value apply_binary(VM* vm, TokenType op, Value left, Value right);
+
+// Flat AST execution. A runtime error stops the program: the statement
+// returns false and the program non-zero.
+int execute_flat_program(VM* vm, const FlatAST* ast);
+Value evaluate_flat_expression(VM* vm, const FlatAST* ast, NodeIndex index);
+bool execute_flat_statement(VM* vm, const FlatAST* ast, NodeIndex index);
 
 // Memory management
 void* vm_alloc(VM* vm, size_t size);
@@ -194,7 +151,7 @@ void push(VM* vm, Value value);
 Value pop(VM* vm);
 Value peek(VM* vm, int offset);
 
-// Symbol table operations
+// Symbol table operations (names must be interned in vm->strings)
 void define_symbol(VM* vm, const char* name, Value value);
 Value get_symbol(VM* vm, const char* name);
 bool has_symbol(VM* vm, const char* name);
@@ -220,8 +177,39 @@ void render_animation(VM* vm, Value animation);
 // VM lifecycle
 void initVM(VM* vm);
 void freeVM(VM* vm);
-InterpretResult interpret(VM* vm, const char* source);
-void compile(VM* vm, const char* source);
+
+// Parse source and run it as bytecode, compiling and executing each
+// top-level statement as soon as it is parsed
+InterpretResult interpret(VM* vm, const char* source, size_t length);
+
+// Compile source, function bodies included, into vm->chunk
+bool compile(VM* vm, const char* source);
+
+// Execute a compiled chunk
+InterpretResult run_chunk(VM* vm, Chunk* chunk);
+
+// Compile source, function bodies included, into vm->register_chunk
+bool compile_registers(VM* vm, const char* source);
+
+// Execute compiled register code. Each frame's registers are a window of
+// vm->stack; the windows of a caller and its callee overlap, since calls
+// are statements and no register is live across one.
+InterpretResult run_register_chunk(VM* vm, RegisterChunk* chunk);
+
+// Parse source, flatten it and run it on the flat tree walker
+InterpretResult interpret_flat(VM* vm, const char* source);
+
+#ifdef VM_COUNT_INSTRUCTIONS
+// Built with -DVM_COUNT_INSTRUCTIONS, both tiers count every instruction
+// they execute here
+extern uint64_t executed_instructions;
+#endif
+
+#ifdef VM_PROFILE_PAIRS
+// Built with -DVM_PROFILE_PAIRS, run() counts each executed instruction
+// against the one that follows it, opcode_pair_counts[first][second]
+extern uint64_t opcode_pair_counts[256][256];
+#endif
 
 // Code fixer operations
 void init_fixer(VM* vm);
@@ -230,14 +218,11 @@ void analyze_code(VM* vm, const char* source);
 void apply_fixes(VM* vm, const char* source, char** fixed_source);
 void print_fixes(VM* vm);
 
-// Table operations
-void initTable(Table* table);
-void freeTable(Table* table);
-bool tableSet(Table* table, const char* key, Value value);
-bool tableGet(Table* table, const char* key, Value* value);
-bool tableDelete(Table* table, const char* key);
-
 // Object operations
+ObjFunction* new_function(VM* vm, const char* name, ASTNode* definition);
+ObjAnimation* new_animation(VM* vm, const char* emoji, const char* action,
+                            int distance, int repeat, int speed);
 void freeObjects(VM* vm);
+void vm_keep_program(VM* vm, ASTNode* program);
 
 #endif // VM_H 
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGNMENT 16
+
+static ArenaBlock* new_block(size_t size, ArenaBlock* next) {
+    ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size);
+    if (!block) {
+        fprintf(stderr, "Failed to allocate arena block\n");
+        exit(1);
+    }
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+Arena* create_arena(size_t block_size) {
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    if (!arena) {
+        fprintf(stderr, "Failed to allocate memory for arena\n");
+        exit(1);
+    }
+    arena->head = NULL;
+    arena->block_size = block_size;
+    arena->total = 0;
+    return arena;
+}
+
+void free_arena(Arena* arena) {
+    if (!arena) return;
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    ArenaBlock* block = arena->head;
+
+    if (!block || block->used + size > block->size) {
+        if (size > arena->block_size / 4) {
+            // Oversized requests get a dedicated block behind the current
+            // one so the rest of the current block isn't wasted
+            ArenaBlock* big = new_block(size, block ? block->next : NULL);
+            if (block) {
+                block->next = big;
+            } else {
+                arena->head = big;
+            }
+            big->used = size;
+            arena->total += size;
+            return big->data;
+        }
+        block = new_block(arena->block_size, block);
+        arena->head = block;
+    }
+
+    void* ptr = block->data + block->used;
+    block->used += size;
+    arena->total += size;
+    return ptr;
+}
+
+void arena_adopt(Arena* arena, Arena* other) {
+    if (!other) return;
+    if (other->head) {
+        // Splice other's chain in behind the block currently being filled
+        ArenaBlock* tail = other->head;
+        while (tail->next) tail = tail->next;
+        if (arena->head) {
+            tail->next = arena->head->next;
+            arena->head->next = other->head;
+        } else {
+            arena->head = other->head;
+        }
+    }
+    arena->total += other->total;
+    free(other);
+}
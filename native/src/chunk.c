@@ -0,0 +1,282 @@
+#include "chunk.h"
+#include "object.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_FORMAT_MAGIC "IBPC"
+#define CHUNK_FORMAT_VERSION 5
+
+void init_chunk(Chunk* chunk) {
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->code = NULL;
+    chunk->lines = NULL;
+    init_value_array(&chunk->constants);
+    chunk->max_stack = 0;
+}
+
+void free_chunk(Chunk* chunk) {
+    free(chunk->code);
+    free(chunk->lines);
+    free_value_array(&chunk->constants);
+    init_chunk(chunk);
+}
+
+void chunk_write(Chunk* chunk, uint8_t byte, int line) {
+    if (chunk->count >= chunk->capacity) {
+        chunk->capacity = chunk->capacity < 64 ? 64 : chunk->capacity * 2;
+        chunk->code = (uint8_t*)realloc(chunk->code, chunk->capacity);
+        chunk->lines = (int*)realloc(chunk->lines, chunk->capacity * sizeof(int));
+        if (!chunk->code || !chunk->lines) {
+            fprintf(stderr, "Failed to grow bytecode chunk\n");
+            exit(1);
+        }
+    }
+    chunk->code[chunk->count] = byte;
+    chunk->lines[chunk->count] = line;
+    chunk->count++;
+}
+
+int chunk_add_constant(Chunk* chunk, Value value) {
+    write_value_array(&chunk->constants, value);
+    return chunk->constants.count - 1;
+}
+
+// Serialization: little-endian fixed-width integers, strings as a u32
+// length followed by their bytes
+
+static void write_u32(FILE* out, uint32_t value) {
+    uint8_t bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    fwrite(bytes, 1, sizeof(bytes), out);
+}
+
+static void write_string(FILE* out, const char* str) {
+    uint32_t length = str ? (uint32_t)strlen(str) : 0;
+    write_u32(out, length);
+    fwrite(str, 1, length, out);
+}
+
+static void write_chunk_body(FILE* out, const Chunk* chunk) {
+    write_u32(out, (uint32_t)chunk->max_stack);
+    write_u32(out, (uint32_t)chunk->count);
+    fwrite(chunk->code, 1, chunk->count, out);
+    for (int i = 0; i < chunk->count; i++) {
+        write_u32(out, (uint32_t)chunk->lines[i]);
+    }
+
+    write_u32(out, (uint32_t)chunk->constants.count);
+    for (int i = 0; i < chunk->constants.count; i++) {
+        Value value = chunk->constants.values[i];
+        ValueType type = value_type(value);
+        fputc(type, out);
+        switch (type) {
+            case VAL_NUMBER:
+                // A number's box is its IEEE-754 bits
+                write_u32(out, (uint32_t)value);
+                write_u32(out, (uint32_t)(value >> 32));
+                break;
+            case VAL_STRING:
+                write_string(out, AS_STRING(value));
+                break;
+            case VAL_BOOLEAN:
+                fputc(AS_BOOL(value), out);
+                break;
+            case VAL_FUNCTION: {
+                // Bodies that were never compiled are written as empty chunks
+                const ObjFunction* function = AS_FUNCTION(value);
+                write_string(out, function->name);
+                if (function->chunk) {
+                    write_chunk_body(out, function->chunk);
+                } else {
+                    Chunk empty;
+                    init_chunk(&empty);
+                    write_chunk_body(out, &empty);
+                }
+                break;
+            }
+            case VAL_ANIMATION: {
+                const ObjAnimation* animation = AS_ANIMATION(value);
+                write_string(out, animation->emoji);
+                write_string(out, animation->action);
+                write_u32(out, (uint32_t)animation->distance);
+                write_u32(out, (uint32_t)animation->repeat);
+                write_u32(out, (uint32_t)animation->speed);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+// Header, global slot names in slot order, then the top-level chunk
+void write_chunk(FILE* out, const Chunk* chunk, const char** globals, int global_count) {
+    fwrite(CHUNK_FORMAT_MAGIC, 1, 4, out);
+    fputc(CHUNK_FORMAT_VERSION, out);
+    write_u32(out, (uint32_t)global_count);
+    for (int i = 0; i < global_count; i++) {
+        write_string(out, globals[i]);
+    }
+    write_chunk_body(out, chunk);
+}
+
+const char* opcode_name(uint8_t op) {
+    switch (op) {
+        case OP_CONSTANT: return "OP_CONSTANT";
+        case OP_NULL: return "OP_NULL";
+        case OP_TRUE: return "OP_TRUE";
+        case OP_FALSE: return "OP_FALSE";
+        case OP_POP: return "OP_POP";
+        case OP_GET_GLOBAL: return "OP_GET_GLOBAL";
+        case OP_DEFINE_GLOBAL: return "OP_DEFINE_GLOBAL";
+        case OP_EQUAL: return "OP_EQUAL";
+        case OP_GREATER: return "OP_GREATER";
+        case OP_LESS: return "OP_LESS";
+        case OP_GREATER_EQUAL: return "OP_GREATER_EQUAL";
+        case OP_LESS_EQUAL: return "OP_LESS_EQUAL";
+        case OP_ADD: return "OP_ADD";
+        case OP_SUBTRACT: return "OP_SUBTRACT";
+        case OP_MULTIPLY: return "OP_MULTIPLY";
+        case OP_DIVIDE: return "OP_DIVIDE";
+        case OP_NOT: return "OP_NOT";
+        case OP_NEGATE: return "OP_NEGATE";
+        case OP_PRINT: return "OP_PRINT";
+        case OP_INPUT: return "OP_INPUT";
+        case OP_TO_NUMBER: return "OP_TO_NUMBER";
+        case OP_GAME_ENGINE: return "OP_GAME_ENGINE";
+        case OP_ANIMATE: return "OP_ANIMATE";
+        case OP_CALL: return "OP_CALL";
+        case OP_TAIL_CALL: return "OP_TAIL_CALL";
+        case OP_RETURN: return "OP_RETURN";
+        case OP_CALL_GLOBAL: return "OP_CALL_GLOBAL";
+        case OP_TAIL_CALL_GLOBAL: return "OP_TAIL_CALL_GLOBAL";
+        case OP_PRINT_CONSTANT: return "OP_PRINT_CONSTANT";
+        case OP_ADD_CONSTANT: return "OP_ADD_CONSTANT";
+        case OP_SUBTRACT_CONSTANT: return "OP_SUBTRACT_CONSTANT";
+        case OP_MULTIPLY_CONSTANT: return "OP_MULTIPLY_CONSTANT";
+        case OP_DIVIDE_CONSTANT: return "OP_DIVIDE_CONSTANT";
+        default: return NULL;
+    }
+}
+
+int instruction_length(uint8_t op) {
+    switch (op) {
+        case OP_GET_GLOBAL:
+        case OP_DEFINE_GLOBAL:
+        case OP_CALL_GLOBAL:
+        case OP_TAIL_CALL_GLOBAL:
+            return 4;
+        case OP_CONSTANT:
+        case OP_INPUT:
+        case OP_PRINT_CONSTANT:
+        case OP_ADD_CONSTANT:
+        case OP_SUBTRACT_CONSTANT:
+        case OP_MULTIPLY_CONSTANT:
+        case OP_DIVIDE_CONSTANT:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+int stack_effect(uint8_t op) {
+    switch (op) {
+        case OP_CONSTANT:
+        case OP_NULL:
+        case OP_TRUE:
+        case OP_FALSE:
+        case OP_GET_GLOBAL:
+        case OP_INPUT:
+            return 1;
+        case OP_POP:
+        case OP_DEFINE_GLOBAL:
+        case OP_EQUAL:
+        case OP_GREATER:
+        case OP_LESS:
+        case OP_GREATER_EQUAL:
+        case OP_LESS_EQUAL:
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_PRINT:
+        case OP_ANIMATE:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+            return -1;
+        default:
+            return 0;
+    }
+}
+
+static void print_constant(Value value) {
+    switch (value_type(value)) {
+        case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
+        case VAL_STRING: printf("\"%s\"", AS_STRING(value)); break;
+        case VAL_BOOLEAN: printf("%s", AS_BOOL(value) ? "true" : "false"); break;
+        case VAL_FUNCTION: printf("<function %s>", AS_FUNCTION(value)->name); break;
+        case VAL_ANIMATION: printf("<animation %s %s>", AS_ANIMATION(value)->emoji, AS_ANIMATION(value)->action); break;
+        default: printf("null"); break;
+    }
+}
+
+int disassemble_instruction(const Chunk* chunk, int offset, const char** globals) {
+    printf("%04d ", offset);
+    if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
+        printf("   | ");
+    } else {
+        printf("%4d ", chunk->lines[offset]);
+    }
+
+    uint8_t op = chunk->code[offset];
+    const char* name = opcode_name(op);
+    if (!name) {
+        printf("Unknown opcode %d\n", op);
+        return offset + 1;
+    }
+
+    switch (op) {
+        case OP_GET_GLOBAL:
+        case OP_DEFINE_GLOBAL:
+        case OP_CALL_GLOBAL:
+        case OP_TAIL_CALL_GLOBAL: {
+            const uint8_t* operand = &chunk->code[offset + 1];
+            int slot = (operand[0] << 16) | (operand[1] << 8) | operand[2];
+            printf("%-20s %4d", name, slot);
+            if (globals) printf(" '%s'", globals[slot]);
+            printf("\n");
+            return offset + 4;
+        }
+        case OP_CONSTANT:
+        case OP_INPUT:
+        case OP_PRINT_CONSTANT:
+        case OP_ADD_CONSTANT:
+        case OP_SUBTRACT_CONSTANT:
+        case OP_MULTIPLY_CONSTANT:
+        case OP_DIVIDE_CONSTANT: {
+            int index = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            printf("%-20s %4d '", name, index);
+            print_constant(chunk->constants.values[index]);
+            printf("'\n");
+            return offset + 3;
+        }
+        default:
+            printf("%s\n", name);
+            return offset + 1;
+    }
+}
+
+void disassemble_chunk(const Chunk* chunk, const char* name, const char** globals) {
+    printf("== %s ==\n", name);
+    for (int offset = 0; offset < chunk->count;) {
+        offset = disassemble_instruction(chunk, offset, globals);
+    }
+
+    // Compiled function bodies follow their parent
+    for (int i = 0; i < chunk->constants.count; i++) {
+        Value value = chunk->constants.values[i];
+        if (!IS_FUNCTION(value)) continue;
+        const ObjFunction* function = AS_FUNCTION(value);
+        if (function->chunk) disassemble_chunk(function->chunk, function->name, globals);
+    }
+}
@@ -0,0 +1,331 @@
+#include "compiler.h"
+#include "resolver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CONSTANTS (UINT16_MAX + 1)
+#define MAX_GLOBALS (1 << 24)
+
+static void compile_expression(Compiler* compiler, ASTNode* node);
+
+void init_compiler(Compiler* compiler, VM* vm, Chunk* chunk, bool lazy) {
+    compiler->vm = vm;
+    compiler->chunk = chunk;
+    compiler->lazy = lazy;
+    compiler->had_error = false;
+    initTable(&compiler->string_constants);
+    compiler->last_call = -1;
+}
+
+void free_compiler(Compiler* compiler) {
+    freeTable(&compiler->string_constants);
+}
+
+static void emit_byte(Compiler* compiler, uint8_t byte, int line) {
+    chunk_write(compiler->chunk, byte, line);
+}
+
+// Emit an instruction with a 16-bit operand
+static void emit_indexed(Compiler* compiler, OpCode op, int index, int line) {
+    emit_byte(compiler, op, line);
+    emit_byte(compiler, (uint8_t)(index >> 8), line);
+    emit_byte(compiler, (uint8_t)index, line);
+}
+
+// Emit an instruction with a 24-bit global slot operand
+static void emit_slot(Compiler* compiler, OpCode op, int slot, int line) {
+    if (slot >= MAX_GLOBALS) {
+        if (!compiler->had_error) {
+            fprintf(stderr, "Too many global names at line %d\n", line);
+        }
+        compiler->had_error = true;
+        slot = 0;
+    }
+    emit_byte(compiler, op, line);
+    emit_byte(compiler, (uint8_t)(slot >> 16), line);
+    emit_byte(compiler, (uint8_t)(slot >> 8), line);
+    emit_byte(compiler, (uint8_t)slot, line);
+}
+
+static int make_constant(Compiler* compiler, Value value, int line) {
+    if (compiler->chunk->constants.count >= MAX_CONSTANTS) {
+        if (!compiler->had_error) {
+            fprintf(stderr, "Too many constants in one chunk at line %d\n", line);
+        }
+        compiler->had_error = true;
+        return 0;
+    }
+    return chunk_add_constant(compiler->chunk, value);
+}
+
+// Constant for an interned string, reusing the slot of an earlier use of
+// the same handle
+static int string_constant(Compiler* compiler, const char* handle, int line) {
+    Value index;
+    if (tableGet(&compiler->string_constants, handle, &index)) {
+        return (int)AS_NUMBER(index);
+    }
+
+    int constant = make_constant(compiler, STRING_VAL(handle), line);
+    tableSet(&compiler->string_constants, handle, NUMBER_VAL(constant));
+    return constant;
+}
+
+static void emit_constant(Compiler* compiler, Value value, int line) {
+    emit_indexed(compiler, OP_CONSTANT, make_constant(compiler, value, line), line);
+}
+
+static void compile_unary(Compiler* compiler, ASTNode* node) {
+    compile_expression(compiler, node->data.unary.operand);
+    emit_byte(compiler, node->data.unary.op == TOKEN_BANG ? OP_NOT : OP_NEGATE, node->line);
+}
+
+static void compile_binary(Compiler* compiler, ASTNode* node) {
+    compile_expression(compiler, node->data.binary.left);
+    compile_expression(compiler, node->data.binary.right);
+
+    int line = node->line;
+    switch (node->data.binary.op) {
+        case TOKEN_PLUS: emit_byte(compiler, OP_ADD, line); break;
+        case TOKEN_MINUS: emit_byte(compiler, OP_SUBTRACT, line); break;
+        case TOKEN_MULTIPLY: emit_byte(compiler, OP_MULTIPLY, line); break;
+        case TOKEN_DIVIDE: emit_byte(compiler, OP_DIVIDE, line); break;
+        case TOKEN_EQ: emit_byte(compiler, OP_EQUAL, line); break;
+        case TOKEN_NEQ:
+            emit_byte(compiler, OP_EQUAL, line);
+            emit_byte(compiler, OP_NOT, line);
+            break;
+        case TOKEN_LT: emit_byte(compiler, OP_LESS, line); break;
+        case TOKEN_GT: emit_byte(compiler, OP_GREATER, line); break;
+        case TOKEN_LTE: emit_byte(compiler, OP_LESS_EQUAL, line); break;
+        case TOKEN_GTE: emit_byte(compiler, OP_GREATER_EQUAL, line); break;
+        default:
+            fprintf(stderr, "Unknown binary operator at line %d\n", line);
+            compiler->had_error = true;
+            break;
+    }
+}
+
+static void compile_expression(Compiler* compiler, ASTNode* node) {
+    if (!node) {
+        emit_byte(compiler, OP_NULL, 0);
+        return;
+    }
+
+    int line = node->line;
+    switch (node->type) {
+        case NODE_NUMBER:
+            emit_constant(compiler, NUMBER_VAL(node->data.number.value), line);
+            break;
+        case NODE_STRING_LITERAL:
+            emit_indexed(compiler, OP_CONSTANT,
+                         string_constant(compiler, node->data.string_literal.value, line), line);
+            break;
+        case NODE_TEXT:
+            emit_indexed(compiler, OP_CONSTANT,
+                         string_constant(compiler, node->data.text.content, line), line);
+            break;
+        case NODE_BOOLEAN:
+            emit_byte(compiler, node->data.boolean.value ? OP_TRUE : OP_FALSE, line);
+            break;
+        case NODE_IDENTIFIER:
+            emit_slot(compiler, OP_GET_GLOBAL, node_slot(compiler->vm, node), line);
+            break;
+        case NODE_INPUT:
+            emit_indexed(compiler, OP_INPUT,
+                         string_constant(compiler, node->data.input.prompt, line), line);
+            break;
+        case NODE_NUMBER_CONVERSION:
+            compile_expression(compiler, node->data.number_conversion.expr);
+            emit_byte(compiler, OP_TO_NUMBER, line);
+            break;
+        case NODE_ANIMATION: {
+            // Animations are immutable, so the whole record is one constant
+            ObjAnimation* animation = new_animation(compiler->vm, node->data.animation.emoji,
+                                                    node->data.animation.action,
+                                                    node->data.animation.distance,
+                                                    node->data.animation.repeat,
+                                                    node->data.animation.speed);
+            emit_constant(compiler, OBJ_VAL(animation), line);
+            break;
+        }
+        case NODE_UNARY:
+            compile_unary(compiler, node);
+            break;
+        case NODE_BINARY:
+            compile_binary(compiler, node);
+            break;
+        default:
+            fprintf(stderr, "Cannot compile expression of type %d at line %d\n", node->type, line);
+            compiler->had_error = true;
+            break;
+    }
+}
+
+static void compile_function_definition(Compiler* compiler, ASTNode* node) {
+    ObjFunction* function = new_function(compiler->vm, node->data.function_definition.name, node);
+    if (!compiler->lazy && !compile_function(compiler->vm, function, false)) {
+        compiler->had_error = true;
+    }
+
+    emit_constant(compiler, OBJ_VAL(function), node->line);
+    emit_slot(compiler, OP_DEFINE_GLOBAL, node_slot(compiler->vm, node), node->line);
+}
+
+void compile_statement(Compiler* compiler, ASTNode* node) {
+    if (!node) return;
+
+    int line = node->line;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                compile_statement(compiler, node->data.program.statements[i]);
+            }
+            break;
+        case NODE_FUNCTION_DEFINITION:
+            compile_function_definition(compiler, node);
+            break;
+        case NODE_TEXT:
+            if (node->data.text.expr) {
+                compile_expression(compiler, node->data.text.expr);
+            } else {
+                compile_expression(compiler, node);
+            }
+            emit_byte(compiler, OP_PRINT, line);
+            break;
+        case NODE_IDENTIFIER:
+            // A bare name as a statement is a call
+            compile_expression(compiler, node);
+            compiler->last_call = compiler->chunk->count;
+            emit_byte(compiler, OP_CALL, line);
+            break;
+        case NODE_GAME_ENGINE:
+            emit_byte(compiler, OP_GAME_ENGINE, line);
+            for (int i = 0; i < node->data.game_engine.animation_count; i++) {
+                compile_expression(compiler, node->data.game_engine.animations[i]);
+                emit_byte(compiler, OP_ANIMATE, line);
+            }
+            break;
+        default:
+            // Any other expression is evaluated for its effects
+            compile_expression(compiler, node);
+            emit_byte(compiler, OP_POP, line);
+            break;
+    }
+}
+
+// Opcode that fuses an instruction with the op that follows it, or
+// OP_RETURN if the pair has no superinstruction
+static uint8_t fused_opcode(uint8_t first, uint8_t second) {
+    if (first == OP_GET_GLOBAL) {
+        if (second == OP_CALL) return OP_CALL_GLOBAL;
+        if (second == OP_TAIL_CALL) return OP_TAIL_CALL_GLOBAL;
+    } else if (first == OP_CONSTANT) {
+        switch (second) {
+            case OP_PRINT: return OP_PRINT_CONSTANT;
+            case OP_ADD: return OP_ADD_CONSTANT;
+            case OP_SUBTRACT: return OP_SUBTRACT_CONSTANT;
+            case OP_MULTIPLY: return OP_MULTIPLY_CONSTANT;
+            case OP_DIVIDE: return OP_DIVIDE_CONSTANT;
+            default: break;
+        }
+    }
+    return OP_RETURN;
+}
+
+// Rewrite the finished chunk in place. Chunks are straight-line code, so
+// instructions can shrink without patching any offsets. A constant
+// converted to a number becomes the number, and an instruction followed
+// by a one-byte op that fuses with it takes the fused opcode; the fused
+// instruction keeps its operand and the line of the first.
+static void peephole(Compiler* compiler) {
+    Chunk* chunk = compiler->chunk;
+    int write = 0;
+    int last = -1;           // Offset of the last instruction written
+    for (int read = 0; read < chunk->count;) {
+        uint8_t op = chunk->code[read];
+        int length = instruction_length(op);
+
+        if (last >= 0) {
+            uint8_t* previous = &chunk->code[last];
+            if (op == OP_TO_NUMBER && *previous == OP_CONSTANT &&
+                chunk->constants.count < MAX_CONSTANTS) {
+                Value constant = chunk->constants.values[(previous[1] << 8) | previous[2]];
+                int index = chunk_add_constant(chunk, convert_to_number(constant));
+                previous[1] = (uint8_t)(index >> 8);
+                previous[2] = (uint8_t)index;
+                read += length;
+                continue;
+            }
+
+            uint8_t fused = fused_opcode(*previous, op);
+            if (fused != OP_RETURN) {
+                *previous = fused;
+                last = -1;
+                read += length;
+                continue;
+            }
+        }
+
+        memmove(&chunk->code[write], &chunk->code[read], length);
+        memmove(&chunk->lines[write], &chunk->lines[read], length * sizeof(int));
+        last = write;
+        write += length;
+        read += length;
+    }
+    chunk->count = write;
+}
+
+// Deepest the stack gets running the chunk, the running sum of the stack
+// effects of its straight-line code
+static int max_stack_depth(const Chunk* chunk) {
+    int depth = 0;
+    int max = 0;
+    for (int offset = 0; offset < chunk->count; offset += instruction_length(chunk->code[offset])) {
+        depth += stack_effect(chunk->code[offset]);
+        if (depth > max) max = depth;
+    }
+    return max;
+}
+
+void emit_return(Compiler* compiler, int line) {
+    if (compiler->last_call >= 0 && compiler->last_call == compiler->chunk->count - 1) {
+        compiler->chunk->code[compiler->last_call] = OP_TAIL_CALL;
+    }
+    emit_byte(compiler, OP_RETURN, line);
+    peephole(compiler);
+    compiler->chunk->max_stack = max_stack_depth(compiler->chunk);
+}
+
+bool compile_program(Compiler* compiler, ASTNode* program) {
+    compile_statement(compiler, program);
+    emit_return(compiler, 0);
+    return !compiler->had_error;
+}
+
+bool compile_function(VM* vm, ObjFunction* function, bool lazy) {
+    ASTNode* body = parse_function_body(function->definition);
+    if (!body) return false;
+    resolve_ast(vm, body);
+
+    Chunk* chunk = (Chunk*)malloc(sizeof(Chunk));
+    if (!chunk) {
+        fprintf(stderr, "Failed to allocate memory for function chunk\n");
+        exit(1);
+    }
+    init_chunk(chunk);
+
+    Compiler compiler;
+    init_compiler(&compiler, vm, chunk, lazy);
+    bool ok = compile_program(&compiler, body);
+    free_compiler(&compiler);
+    if (!ok) {
+        free_chunk(chunk);
+        free(chunk);
+        return false;
+    }
+
+    function->chunk = chunk;
+    return true;
+}
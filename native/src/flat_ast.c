@@ -0,0 +1,196 @@
+#include "flat_ast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reserve count consecutive nodes and return the first index.
+// The node array may move, so callers hold indices, never pointers.
+static NodeIndex reserve_nodes(FlatAST* ast, int count) {
+    if (ast->count + count > ast->capacity) {
+        int capacity = ast->capacity < 64 ? 64 : ast->capacity;
+        while (capacity < ast->count + count) capacity *= 2;
+        ast->nodes = (FlatNode*)realloc(ast->nodes, capacity * sizeof(FlatNode));
+        if (!ast->nodes) {
+            fprintf(stderr, "Failed to allocate memory for flat AST\n");
+            exit(1);
+        }
+        ast->capacity = capacity;
+    }
+    NodeIndex first = (NodeIndex)ast->count;
+    ast->count += count;
+    return first;
+}
+
+static void flatten_into(FlatAST* ast, NodeIndex index, ASTNode* node);
+
+static NodeIndex flatten_child(FlatAST* ast, ASTNode* node) {
+    if (!node) return NO_NODE;
+    NodeIndex index = reserve_nodes(ast, 1);
+    flatten_into(ast, index, node);
+    return index;
+}
+
+// Lay out a list's nodes side by side, then fill in each one (their own
+// children go after the whole list)
+static NodeIndex flatten_list(FlatAST* ast, ASTNode** list, int count) {
+    if (count == 0) return NO_NODE;
+    NodeIndex first = reserve_nodes(ast, count);
+    for (int i = 0; i < count; i++) {
+        flatten_into(ast, first + i, list[i]);
+    }
+    return first;
+}
+
+static void flatten_into(FlatAST* ast, NodeIndex index, ASTNode* node) {
+    FlatNode flat;
+    memset(&flat, 0, sizeof(flat));
+    flat.type = node->type;
+    flat.line = node->line;
+
+    switch (node->type) {
+        case NODE_PROGRAM:
+            flat.data.program.count = node->data.program.statement_count;
+            flat.data.program.first = flatten_list(ast, node->data.program.statements,
+                                                   node->data.program.statement_count);
+            break;
+        case NODE_FUNCTION_DEFINITION:
+            flat.data.function_definition.name = node->data.function_definition.name;
+            // The flat layout has no pending bodies, so lazy ones are parsed now
+            flat.data.function_definition.body =
+                flatten_child(ast, parse_function_body(node));
+            break;
+        case NODE_TEXT:
+            flat.data.text.content = node->data.text.content;
+            flat.data.text.expr = flatten_child(ast, node->data.text.expr);
+            break;
+        case NODE_STRING_LITERAL:
+            flat.data.string_literal.value = node->data.string_literal.value;
+            break;
+        case NODE_NUMBER:
+            flat.data.number.value = node->data.number.value;
+            break;
+        case NODE_IDENTIFIER:
+            flat.data.identifier.name = node->data.identifier.name;
+            break;
+        case NODE_INPUT:
+            flat.data.input.prompt = node->data.input.prompt;
+            break;
+        case NODE_NUMBER_CONVERSION:
+            flat.data.number_conversion.expr = flatten_child(ast, node->data.number_conversion.expr);
+            break;
+        case NODE_GAME_ENGINE:
+            flat.data.game_engine.expr = flatten_child(ast, node->data.game_engine.expr);
+            flat.data.game_engine.animation_count = node->data.game_engine.animation_count;
+            flat.data.game_engine.first_animation = flatten_list(ast, node->data.game_engine.animations,
+                                                                 node->data.game_engine.animation_count);
+            break;
+        case NODE_ANIMATION:
+            flat.data.animation.emoji = node->data.animation.emoji;
+            flat.data.animation.action = node->data.animation.action;
+            flat.data.animation.distance = node->data.animation.distance;
+            flat.data.animation.repeat = node->data.animation.repeat;
+            flat.data.animation.speed = node->data.animation.speed;
+            break;
+        case NODE_BOOLEAN:
+            flat.data.boolean.value = node->data.boolean.value;
+            break;
+        case NODE_UNARY:
+            flat.data.unary.op = node->data.unary.op;
+            flat.data.unary.operand = flatten_child(ast, node->data.unary.operand);
+            break;
+        case NODE_BINARY:
+            flat.data.binary.op = node->data.binary.op;
+            flat.data.binary.left = flatten_child(ast, node->data.binary.left);
+            flat.data.binary.right = flatten_child(ast, node->data.binary.right);
+            break;
+        default:
+            break;
+    }
+
+    ast->nodes[index] = flat;
+}
+
+FlatAST* flatten_ast(ASTNode* root) {
+    FlatAST* ast = (FlatAST*)malloc(sizeof(FlatAST));
+    if (!ast) {
+        fprintf(stderr, "Failed to allocate memory for flat AST\n");
+        return NULL;
+    }
+    ast->nodes = NULL;
+    ast->count = 0;
+    ast->capacity = 0;
+    ast->root = flatten_child(ast, root);
+    return ast;
+}
+
+void free_flat_ast(FlatAST* ast) {
+    if (!ast) return;
+    free(ast->nodes);
+    free(ast);
+}
+
+// Print flat AST for debugging (same format as print_ast)
+void print_flat_ast(const FlatAST* ast, NodeIndex index, int depth) {
+    if (index == NO_NODE) return;
+    const FlatNode* node = &ast->nodes[index];
+
+    for (int i = 0; i < depth; i++) printf("  ");
+
+    switch (node->type) {
+        case NODE_PROGRAM: {
+            printf("Program (%d statements)\n", node->data.program.count);
+            NodeIndex end = node->data.program.first + node->data.program.count;
+            for (NodeIndex i = node->data.program.first; i < end; i++) {
+                print_flat_ast(ast, i, depth + 1);
+            }
+            break;
+        }
+        case NODE_FUNCTION_DEFINITION:
+            printf("Function: %s\n", node->data.function_definition.name);
+            print_flat_ast(ast, node->data.function_definition.body, depth + 1);
+            break;
+        case NODE_TEXT:
+            if (node->data.text.content) {
+                printf("Text: %s\n", node->data.text.content);
+            } else {
+                printf("Text:\n");
+                print_flat_ast(ast, node->data.text.expr, depth + 1);
+            }
+            break;
+        case NODE_STRING_LITERAL:
+            printf("String: %s\n", node->data.string_literal.value);
+            break;
+        case NODE_NUMBER:
+            printf("Number: %f\n", node->data.number.value);
+            break;
+        case NODE_IDENTIFIER:
+            printf("Identifier: %s\n", node->data.identifier.name);
+            break;
+        case NODE_INPUT:
+            printf("Input: %s\n", node->data.input.prompt);
+            break;
+        case NODE_NUMBER_CONVERSION:
+            printf("Number conversion:\n");
+            print_flat_ast(ast, node->data.number_conversion.expr, depth + 1);
+            break;
+        case NODE_GAME_ENGINE:
+            printf("Game engine:\n");
+            print_flat_ast(ast, node->data.game_engine.expr, depth + 1);
+            break;
+        case NODE_BOOLEAN:
+            printf("Boolean: %s\n", node->data.boolean.value ? "true" : "false");
+            break;
+        case NODE_UNARY:
+            printf("Unary: %s\n", operator_name(node->data.unary.op));
+            print_flat_ast(ast, node->data.unary.operand, depth + 1);
+            break;
+        case NODE_BINARY:
+            printf("Binary: %s\n", operator_name(node->data.binary.op));
+            print_flat_ast(ast, node->data.binary.left, depth + 1);
+            print_flat_ast(ast, node->data.binary.right, depth + 1);
+            break;
+        default:
+            printf("Unknown node type\n");
+            break;
+    }
+}
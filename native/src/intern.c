@@ -0,0 +1,111 @@
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERNER_INITIAL_CAPACITY 256
+#define INTERNER_MAX_LOAD 0.75
+
+uint32_t hash_string(const char* chars, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void init_interner(Interner* interner) {
+    interner->entries = NULL;
+    interner->count = 0;
+    interner->capacity = 0;
+    interner->lock = NULL;
+}
+
+void free_interner(Interner* interner) {
+    for (int i = 0; i < interner->capacity; i++) {
+        free(interner->entries[i]);
+    }
+    free(interner->entries);
+    init_interner(interner);
+}
+
+// Slot holding chars, or the empty slot where it would go (linear probing)
+static InternedString** find_slot(InternedString** entries, int capacity,
+                                  const char* chars, size_t length, uint32_t hash) {
+    uint32_t index = hash & (capacity - 1);
+    for (;;) {
+        InternedString* entry = entries[index];
+        if (!entry) return &entries[index];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->chars, chars, length) == 0) {
+            return &entries[index];
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+static void grow(Interner* interner) {
+    int capacity = interner->capacity < INTERNER_INITIAL_CAPACITY
+        ? INTERNER_INITIAL_CAPACITY : interner->capacity * 2;
+    InternedString** entries = (InternedString**)calloc(capacity, sizeof(InternedString*));
+    if (!entries) {
+        fprintf(stderr, "Failed to allocate memory for string interner\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < interner->capacity; i++) {
+        InternedString* entry = interner->entries[i];
+        if (!entry) continue;
+        *find_slot(entries, capacity, entry->chars, entry->length, entry->hash) = entry;
+    }
+
+    free(interner->entries);
+    interner->entries = entries;
+    interner->capacity = capacity;
+}
+
+static const char* intern_unlocked(Interner* interner, const char* chars, size_t length) {
+    if (interner->count + 1 > interner->capacity * INTERNER_MAX_LOAD) {
+        grow(interner);
+    }
+
+    uint32_t hash = hash_string(chars, length);
+    InternedString** slot = find_slot(interner->entries, interner->capacity, chars, length, hash);
+    if (*slot) return (*slot)->chars;
+
+    InternedString* entry = (InternedString*)malloc(sizeof(InternedString) + length + 1);
+    if (!entry) {
+        fprintf(stderr, "Failed to allocate memory for interned string\n");
+        exit(1);
+    }
+    entry->hash = hash;
+    entry->length = (uint32_t)length;
+    memcpy(entry->chars, chars, length);
+    entry->chars[length] = '\0';
+
+    *slot = entry;
+    interner->count++;
+    return entry->chars;
+}
+
+const char* intern(Interner* interner, const char* chars, size_t length) {
+    if (!interner->lock) return intern_unlocked(interner, chars, length);
+
+    pthread_mutex_lock(interner->lock);
+    const char* handle = intern_unlocked(interner, chars, length);
+    pthread_mutex_unlock(interner->lock);
+    return handle;
+}
+
+const char* intern_find(const Interner* interner, const char* chars, size_t length) {
+    if (interner->lock) pthread_mutex_lock(interner->lock);
+    const char* handle = NULL;
+    if (interner->count > 0) {
+        uint32_t hash = hash_string(chars, length);
+        InternedString** slot = find_slot(interner->entries, interner->capacity, chars, length, hash);
+        if (*slot) handle = (*slot)->chars;
+    }
+    if (interner->lock) pthread_mutex_unlock(interner->lock);
+    return handle;
+}
@@ -1,4 +1,6 @@
 #include "lexer.h"
+#include "scan.h"
+#include "number.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,28 +10,48 @@
 #define MAX_LINE_LENGTH 1024
 
 // Forward declarations of helper functions
-static Token make_token(TokenType type, const char* value, Lexer* lexer);
+static Token make_token(TokenType type, size_t start, int line, int column, Lexer* lexer);
 static Token identifier_or_keyword(Lexer* lexer);
 static Token number(Lexer* lexer);
 static Token string(Lexer* lexer);
 
+// Keyword table indexed by a perfect hash of (first char, last char, length).
+// Every keyword lands in its own slot, so classifying an identifier costs one
+// hash and one compare. Adding a keyword that collides with an existing slot
+// shows up as an overridden initializer under -Wextra; pick new multipliers
+// in KEYWORD_HASH if that happens.
+#define KEYWORD_SLOTS 32
+#define KEYWORD_HASH(first, last, length) \
+    (((unsigned)(unsigned char)(first) * 6 + (unsigned)(unsigned char)(last) * 2 + \
+      (unsigned)(length) * 3) & (KEYWORD_SLOTS - 1))
+#define KEYWORD(text, first, last, token) \
+    [KEYWORD_HASH(first, last, sizeof(text) - 1)] = {text, sizeof(text) - 1, token}
+
 typedef struct {
     const char* keyword;
+    int length;
     TokenType type;
 } Keyword;
 
-static const Keyword keywords[] = {
-    {"function", TOKEN_FUNCTION},
-    {"class", TOKEN_CLASS},
-    {"if", TOKEN_IF},
-    {"else", TOKEN_ELSE},
-    {"while", TOKEN_WHILE},
-    {"return", TOKEN_RETURN},
-    {"true", TOKEN_TRUE},
-    {"false", TOKEN_FALSE},
-    {"input", TOKEN_INPUT},
-    {"text", TOKEN_TEXT},
-    {"num", TOKEN_NUM}
+static const Keyword keywords[KEYWORD_SLOTS] = {
+    KEYWORD("function", 'f', 'n', TOKEN_FUNCTION),
+    KEYWORD("class", 'c', 's', TOKEN_CLASS),
+    KEYWORD("if", 'i', 'f', TOKEN_IF),
+    KEYWORD("else", 'e', 'e', TOKEN_ELSE),
+    KEYWORD("while", 'w', 'e', TOKEN_WHILE),
+    KEYWORD("return", 'r', 'n', TOKEN_RETURN),
+    KEYWORD("true", 't', 'e', TOKEN_TRUE),
+    KEYWORD("false", 'f', 'e', TOKEN_FALSE),
+    KEYWORD("input", 'i', 't', TOKEN_INPUT),
+    KEYWORD("text", 't', 't', TOKEN_TEXT),
+    KEYWORD("num", 'n', 'm', TOKEN_NUM),
+    KEYWORD("game_engine", 'g', 'e', TOKEN_GAME_ENGINE),
+    KEYWORD("animate", 'a', 'e', TOKEN_ANIMATE),
+    KEYWORD("fly", 'f', 'y', TOKEN_FLY),
+    KEYWORD("down", 'd', 'n', TOKEN_DOWN),
+    KEYWORD("repeat", 'r', 't', TOKEN_REPEAT),
+    KEYWORD("speed", 's', 'd', TOKEN_SPEED),
+    KEYWORD("px", 'p', 'x', TOKEN_PX)
 };
 
 static struct {
@@ -52,38 +74,56 @@ static struct {
     {'}', TOKEN_RBRACE}
 };
 
-static TokenType check_keyword(const char* identifier) {
-    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
-        if (strcmp(identifier, keywords[i].keyword) == 0) {
-            return keywords[i].type;
-        }
+// Classify an identifier span as a keyword or TOKEN_IDENTIFIER
+TokenType lookup_keyword(const char* start, int length) {
+    if (length < 2) return TOKEN_IDENTIFIER;
+    const Keyword* keyword = &keywords[KEYWORD_HASH(start[0], start[length - 1], length)];
+    if (keyword->length == length && memcmp(keyword->keyword, start, length) == 0) {
+        return keyword->type;
     }
     return TOKEN_IDENTIFIER;
 }
 
-// Helper function to create a token
-static Token make_token(TokenType type, const char* value, Lexer* lexer) {
+// Helper function to create a token spanning [start, position)
+static Token make_token(TokenType type, size_t start, int line, int column, Lexer* lexer) {
     Token token;
     token.type = type;
-    if (value) {
-        token.value.string_val = strdup(value);
-    }
-    token.line = lexer->line;
-    token.column = lexer->column;
+    token.offset = lexer->base + start;
+    token.length = (int)(lexer->position - start);
+    token.line = line;
+    token.column = column;
     return token;
 }
 
 // Helper function to advance the lexer
 static void advance(Lexer* lexer) {
-    if (lexer->position < strlen(lexer->source)) {
+    if (lexer->position < lexer->length) {
+        if (lexer->source[lexer->position] == '\n') {
+            lexer->line++;
+            lexer->column = 0;
+        }
         lexer->position++;
         lexer->column++;
     }
 }
 
+// Helper function to jump the lexer forward to new_position, keeping
+// line/column in step with any newlines skipped over
+static void advance_to(Lexer* lexer, size_t new_position) {
+    size_t last_newline = 0;
+    int newlines = scan_count_newlines(lexer->source, lexer->position, new_position, &last_newline);
+    if (newlines > 0) {
+        lexer->line += newlines;
+        lexer->column = (int)(new_position - last_newline);
+    } else {
+        lexer->column += (int)(new_position - lexer->position);
+    }
+    lexer->position = new_position;
+}
+
 // Helper function to get current character
 static char current_char(Lexer* lexer) {
-    if (lexer->position >= strlen(lexer->source)) {
+    if (lexer->position >= lexer->length) {
         return '\0';
     }
     return lexer->source[lexer->position];
@@ -91,19 +131,32 @@ static char current_char(Lexer* lexer) {
 
 // Helper function to peek next character
 static char peek_char(Lexer* lexer) {
-    if (lexer->position + 1 >= strlen(lexer->source)) {
+    if (lexer->position + 1 >= lexer->length) {
         return '\0';
     }
     return lexer->source[lexer->position + 1];
 }
 
-// Create a new lexer
-Lexer* create_lexer(const char* source) {
-    Lexer* lexer = (Lexer*)malloc(sizeof(Lexer));
+// Initialize a lexer over length bytes of source
+void init_lexer(Lexer* lexer, const char* source, size_t length) {
     lexer->source = source;
+    lexer->length = length;
+    lexer->base = 0;
     lexer->position = 0;
     lexer->line = 1;
     lexer->column = 1;
+    lexer->error = NULL;
+}
+
+// Create a new lexer over a NUL-terminated source
+Lexer* create_lexer(const char* source) {
+    return create_lexer_with_length(source, strlen(source));
+}
+
+// Create a new lexer over a source of known length
+Lexer* create_lexer_with_length(const char* source, size_t length) {
+    Lexer* lexer = (Lexer*)malloc(sizeof(Lexer));
+    init_lexer(lexer, source, length);
     return lexer;
 }
 
@@ -112,24 +165,268 @@ void free_lexer(Lexer* lexer) {
     free(lexer);
 }
 
+// Pointer to the first byte of a token's lexeme
+const char* token_start(const Lexer* lexer, const Token* token) {
+    return lexer->source + (token->offset - lexer->base);
+}
+
+// Materialize a token's lexeme as a NUL-terminated heap string
+char* token_string(const Lexer* lexer, const Token* token) {
+    char* str = (char*)malloc(token->length + 1);
+    if (!str) {
+        fprintf(stderr, "Failed to allocate memory for token string\n");
+        exit(1);
+    }
+    memcpy(str, token_start(lexer, token), token->length);
+    str[token->length] = '\0';
+    return str;
+}
+
+// Canonical interned copy of a token's lexeme
+const char* token_intern(const Lexer* lexer, const Token* token, Interner* strings) {
+    return intern(strings, token_start(lexer, token), token->length);
+}
+
+// Numeric value of a TOKEN_NUMBER, parsed straight from the source span
+double token_number(const Lexer* lexer, const Token* token) {
+    double value;
+    parse_double(token_start(lexer, token), token->length, &value);
+    return value;
+}
+
+// Compare a token's lexeme against a NUL-terminated string
+bool token_equals(const Lexer* lexer, const Token* token, const char* text) {
+    return strncmp(token_start(lexer, token), text, token->length) == 0 &&
+           text[token->length] == '\0';
+}
+
+// Allocate an empty token buffer with room for capacity tokens
+static TokenBuffer* create_token_buffer(int capacity) {
+    TokenBuffer* buffer = (TokenBuffer*)malloc(sizeof(TokenBuffer));
+    if (!buffer) {
+        fprintf(stderr, "Failed to allocate memory for token buffer\n");
+        exit(1);
+    }
+    buffer->types = (uint8_t*)malloc(capacity * sizeof(uint8_t));
+    buffer->offsets = (size_t*)malloc(capacity * sizeof(size_t));
+    buffer->lengths = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    buffer->lines = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    buffer->columns = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    buffer->count = 0;
+    buffer->capacity = capacity;
+    return buffer;
+}
+
+// Append a token, growing every column array together
+void token_buffer_push(TokenBuffer* buffer, Token token) {
+    if (buffer->count >= buffer->capacity) {
+        buffer->capacity = buffer->capacity < 64 ? 64 : buffer->capacity * 2;
+        buffer->types = (uint8_t*)realloc(buffer->types, buffer->capacity * sizeof(uint8_t));
+        buffer->offsets = (size_t*)realloc(buffer->offsets, buffer->capacity * sizeof(size_t));
+        buffer->lengths = (uint32_t*)realloc(buffer->lengths, buffer->capacity * sizeof(uint32_t));
+        buffer->lines = (uint32_t*)realloc(buffer->lines, buffer->capacity * sizeof(uint32_t));
+        buffer->columns = (uint32_t*)realloc(buffer->columns, buffer->capacity * sizeof(uint32_t));
+        if (!buffer->types || !buffer->offsets || !buffer->lengths ||
+            !buffer->lines || !buffer->columns) {
+            fprintf(stderr, "Failed to grow token buffer\n");
+            exit(1);
+        }
+    }
+    int i = buffer->count++;
+    buffer->types[i] = (uint8_t)token.type;
+    buffer->offsets[i] = token.offset;
+    buffer->lengths[i] = (uint32_t)token.length;
+    buffer->lines[i] = (uint32_t)token.line;
+    buffer->columns[i] = (uint32_t)token.column;
+}
+
+// Lex the rest of the source into a token buffer in one pass
+TokenBuffer* tokenize(Lexer* lexer) {
+    // Roughly one token per six bytes of source in typical scripts
+    size_t estimate = (lexer->length - lexer->position) / 6 + 16;
+    TokenBuffer* buffer = create_token_buffer(estimate > (1 << 24) ? (1 << 24) : (int)estimate);
+    
+    Token token;
+    do {
+        token = get_next_token(lexer);
+        token_buffer_push(buffer, token);
+    } while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR);
+    
+    return buffer;
+}
+
+// One slice of the source lexed on a worker thread
+typedef struct {
+    const char* source;
+    size_t start;
+    size_t end;
+    TokenBuffer* tokens;
+    int newlines;
+} LexChunk;
+
+static void lex_chunk(void* arg) {
+    LexChunk* chunk = (LexChunk*)arg;
+    Lexer lexer;
+    init_lexer(&lexer, chunk->source, chunk->end);
+    lexer.position = chunk->start;
+    chunk->tokens = tokenize(&lexer);
+    chunk->newlines = lexer.line - 1;
+}
+
+// Number of '"' bytes in source[start, end)
+static size_t count_quotes(const char* source, size_t start, size_t end) {
+    size_t count = 0;
+    const char* p = source + start;
+    const char* limit = source + end;
+    while (p < limit && (p = memchr(p, '"', limit - p)) != NULL) {
+        count++;
+        p++;
+    }
+    return count;
+}
+
+// Pick up to max_chunks - 1 split points near evenly spaced targets.
+// A split is only safe just after a newline that isn't inside a string
+// literal; every '"' outside a string opens one, so quote parity from the
+// start of the file says which newlines qualify. Returns the chunk count,
+// with bounds[0..count] holding the chunk edges.
+static int split_source(const char* source, size_t length, int max_chunks, size_t* bounds) {
+    int count = 0;
+    size_t pos = 0;
+    bool in_string = false;
+    bounds[0] = 0;
+    
+    for (int i = 1; i < max_chunks && pos < length; i++) {
+        size_t target = length / max_chunks * i;
+        if (target > pos) {
+            in_string ^= count_quotes(source, pos, target) & 1;
+            pos = target;
+        }
+        
+        // Walk to the next newline outside a string
+        for (;;) {
+            const char* newline = memchr(source + pos, '\n', length - pos);
+            size_t next = newline ? (size_t)(newline - source) : length;
+            in_string ^= count_quotes(source, pos, next) & 1;
+            pos = next;
+            if (pos >= length) break;
+            pos++; // Split just after the newline
+            if (!in_string) break;
+        }
+        if (pos >= length) break;
+        bounds[++count] = pos;
+    }
+    
+    bounds[++count] = length;
+    return count;
+}
+
+// Lex a large source on a thread pool.
+// The source is split at safe newlines, each chunk is lexed independently
+// starting at line 1 (columns are already right because every chunk begins a
+// line), and the chunk buffers are stitched back together with their lines
+// shifted. The result is identical to tokenize() over the whole source.
+TokenBuffer* tokenize_parallel(const char* source, size_t length, ThreadPool* pool) {
+    int max_chunks = pool ? thread_pool_size(pool) * 4 : 1;
+    if ((size_t)max_chunks > length / PARALLEL_LEX_MIN_CHUNK) {
+        max_chunks = (int)(length / PARALLEL_LEX_MIN_CHUNK);
+    }
+    if (max_chunks < 2) {
+        Lexer lexer;
+        init_lexer(&lexer, source, length);
+        return tokenize(&lexer);
+    }
+    
+    size_t* bounds = (size_t*)malloc((max_chunks + 1) * sizeof(size_t));
+    int chunk_count = split_source(source, length, max_chunks, bounds);
+    LexChunk* chunks = (LexChunk*)malloc(chunk_count * sizeof(LexChunk));
+    for (int i = 0; i < chunk_count; i++) {
+        chunks[i].source = source;
+        chunks[i].start = bounds[i];
+        chunks[i].end = bounds[i + 1];
+        chunks[i].tokens = NULL;
+        chunks[i].newlines = 0;
+        thread_pool_submit(pool, lex_chunk, &chunks[i]);
+    }
+    thread_pool_wait(pool);
+    
+    size_t total = 0;
+    for (int i = 0; i < chunk_count; i++) total += chunks[i].tokens->count;
+    TokenBuffer* buffer = create_token_buffer((int)total);
+    
+    // Each chunk ends in an EOF that only belongs in the result if lexing
+    // really stopped there: the last chunk, an error, or an embedded NUL
+    uint32_t line_base = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        TokenBuffer* part = chunks[i].tokens;
+        int last = part->count - 1;
+        bool stops = i == chunk_count - 1 ||
+                     part->types[last] == TOKEN_ERROR ||
+                     part->offsets[last] < chunks[i].end;
+        int n = stops ? part->count : last;
+        
+        int at = buffer->count;
+        memcpy(buffer->types + at, part->types, n * sizeof(uint8_t));
+        memcpy(buffer->offsets + at, part->offsets, n * sizeof(size_t));
+        memcpy(buffer->lengths + at, part->lengths, n * sizeof(uint32_t));
+        memcpy(buffer->columns + at, part->columns, n * sizeof(uint32_t));
+        for (int j = 0; j < n; j++) {
+            buffer->lines[at + j] = part->lines[j] + line_base;
+        }
+        buffer->count += n;
+        line_base += chunks[i].newlines;
+        if (stops) break;
+    }
+    
+    for (int i = 0; i < chunk_count; i++) free_token_buffer(chunks[i].tokens);
+    free(chunks);
+    free(bounds);
+    return buffer;
+}
+
+// Rebuild the token at index; reads past the end return the final token
+Token token_at(const TokenBuffer* buffer, int index) {
+    if (index >= buffer->count) index = buffer->count - 1;
+    Token token;
+    token.type = (TokenType)buffer->types[index];
+    token.offset = buffer->offsets[index];
+    token.length = (int)buffer->lengths[index];
+    token.line = (int)buffer->lines[index];
+    token.column = (int)buffer->columns[index];
+    return token;
+}
+
+// Free token buffer memory
+void free_token_buffer(TokenBuffer* buffer) {
+    if (!buffer) return;
+    free(buffer->types);
+    free(buffer->offsets);
+    free(buffer->lengths);
+    free(buffer->lines);
+    free(buffer->columns);
+    free(buffer);
+}
+
 // Get next token from source
 Token get_next_token(Lexer* lexer) {
-    while (isspace(current_char(lexer))) {
-        advance(lexer);
-    }
+    advance_to(lexer, scan_whitespace(lexer->source, lexer->position, lexer->length));
+    
+    size_t start = lexer->position;
+    int line = lexer->line;
+    int column = lexer->column;
     
     // Check for EOF
     if (current_char(lexer) == '\0') {
-        return make_token(TOKEN_EOF, "", lexer);
+        return make_token(TOKEN_EOF, start, line, column, lexer);
     }
     
     // Identifiers and keywords
-    if (isalpha(current_char(lexer))) {
+    if (isalpha((unsigned char)current_char(lexer))) {
         return identifier_or_keyword(lexer);
     }
     
     // Numbers
-    if (isdigit(current_char(lexer))) {
+    if (isdigit((unsigned char)current_char(lexer))) {
         return number(lexer);
     }
     
@@ -139,77 +436,103 @@ Token get_next_token(Lexer* lexer) {
     }
     
     // Single-character tokens
+    TokenType type = TOKEN_ERROR;
     switch (current_char(lexer)) {
-        case '{': advance(lexer); return make_token(TOKEN_LBRACE, "{", lexer);
-        case '}': advance(lexer); return make_token(TOKEN_RBRACE, "}", lexer);
-        case '+': advance(lexer); return make_token(TOKEN_PLUS, "+", lexer);
-        case '-': advance(lexer); return make_token(TOKEN_MINUS, "-", lexer);
-        case '*': advance(lexer); return make_token(TOKEN_MULTIPLY, "*", lexer);
-        case '/': advance(lexer); return make_token(TOKEN_DIVIDE, "/", lexer);
-        case '(': advance(lexer); return make_token(TOKEN_LPAREN, "(", lexer);
-        case ')': advance(lexer); return make_token(TOKEN_RPAREN, ")", lexer);
-        case ';': advance(lexer); return make_token(TOKEN_SEMICOLON, ";", lexer);
-        case '.': advance(lexer); return make_token(TOKEN_DOT, ".", lexer);
-        case ',': advance(lexer); return make_token(TOKEN_COMMA, ",", lexer);
-    }
-    
-    // If we get here, we have an invalid character
-    char invalid[2] = {current_char(lexer), '\0'};
+        case '{': type = TOKEN_LBRACE; break;
+        case '}': type = TOKEN_RBRACE; break;
+        case '+': type = TOKEN_PLUS; break;
+        case '-': type = TOKEN_MINUS; break;
+        case '*': type = TOKEN_MULTIPLY; break;
+        case '/': type = TOKEN_DIVIDE; break;
+        case '(': type = TOKEN_LPAREN; break;
+        case ')': type = TOKEN_RPAREN; break;
+        case ';': type = TOKEN_SEMICOLON; break;
+        case '.': type = TOKEN_DOT; break;
+        case ',': type = TOKEN_COMMA; break;
+        // One- or two-character operators; the second character is consumed here
+        case '=':
+            type = TOKEN_ASSIGN;
+            if (peek_char(lexer) == '=') {
+                advance(lexer);
+                type = TOKEN_EQ;
+            }
+            break;
+        case '!':
+            type = TOKEN_BANG;
+            if (peek_char(lexer) == '=') {
+                advance(lexer);
+                type = TOKEN_NEQ;
+            }
+            break;
+        case '<':
+            type = TOKEN_LT;
+            if (peek_char(lexer) == '=') {
+                advance(lexer);
+                type = TOKEN_LTE;
+            }
+            break;
+        case '>':
+            type = TOKEN_GT;
+            if (peek_char(lexer) == '=') {
+                advance(lexer);
+                type = TOKEN_GTE;
+            }
+            break;
+    }
+    
+    // If the type is still TOKEN_ERROR, we have an invalid character
+    if (type == TOKEN_ERROR) {
+        lexer->error = "Unexpected character";
+    }
     advance(lexer);
-    return make_token(TOKEN_ERROR, invalid, lexer);
+    return make_token(type, start, line, column, lexer);
 }
 
 static Token identifier_or_keyword(Lexer* lexer) {
-    char buffer[256];
-    int i = 0;
+    size_t start = lexer->position;
+    int line = lexer->line;
+    int column = lexer->column;
     
-    while (isalnum(current_char(lexer)) || current_char(lexer) == '_') {
-        buffer[i++] = current_char(lexer);
-        advance(lexer);
-    }
-    buffer[i] = '\0';
+    // Identifiers never span lines, so only the column moves
+    size_t end = scan_identifier(lexer->source, lexer->position, lexer->length);
+    lexer->column += (int)(end - lexer->position);
+    lexer->position = end;
     
     // Check for keywords
-    if (strcmp(buffer, "function") == 0) return make_token(TOKEN_FUNCTION, buffer, lexer);
-    if (strcmp(buffer, "class") == 0) return make_token(TOKEN_CLASS, buffer, lexer);
-    if (strcmp(buffer, "if") == 0) return make_token(TOKEN_IF, buffer, lexer);
-    if (strcmp(buffer, "else") == 0) return make_token(TOKEN_ELSE, buffer, lexer);
-    if (strcmp(buffer, "while") == 0) return make_token(TOKEN_WHILE, buffer, lexer);
-    if (strcmp(buffer, "return") == 0) return make_token(TOKEN_RETURN, buffer, lexer);
-    if (strcmp(buffer, "true") == 0) return make_token(TOKEN_TRUE, buffer, lexer);
-    if (strcmp(buffer, "false") == 0) return make_token(TOKEN_FALSE, buffer, lexer);
+    TokenType type = lookup_keyword(lexer->source + start, (int)(lexer->position - start));
     
-    return make_token(TOKEN_IDENTIFIER, buffer, lexer);
+    return make_token(type, start, line, column, lexer);
 }
 
 static Token number(Lexer* lexer) {
-    char buffer[256];
-    int i = 0;
+    size_t start = lexer->position;
+    int line = lexer->line;
+    int column = lexer->column;
     
-    while (isdigit(current_char(lexer)) || current_char(lexer) == '.') {
-        buffer[i++] = current_char(lexer);
-        advance(lexer);
-    }
-    buffer[i] = '\0';
+    // Integer, decimal and exponent forms; numbers never span lines
+    size_t length = scan_number(lexer->source + start, lexer->length - start);
+    lexer->position += length;
+    lexer->column += (int)length;
     
-    return make_token(TOKEN_NUMBER, buffer, lexer);
+    return make_token(TOKEN_NUMBER, start, line, column, lexer);
 }
 
 static Token string(Lexer* lexer) {
-    char buffer[256];
-    int i = 0;
+    int line = lexer->line;
+    int column = lexer->column;
     
     advance(lexer); // Skip opening quote
-    while (current_char(lexer) != '"' && current_char(lexer) != '\0') {
-        buffer[i++] = current_char(lexer);
-        advance(lexer);
-    }
-    buffer[i] = '\0';
+    size_t start = lexer->position;
+    advance_to(lexer, scan_string_body(lexer->source, lexer->position, lexer->length));
     
+    // The span covers the string body only, without the quotes
+    Token token = make_token(TOKEN_STRING, start, line, column, lexer);
     if (current_char(lexer) == '"') {
         advance(lexer); // Skip closing quote
-        return make_token(TOKEN_STRING, buffer, lexer);
+        return token;
     }
     
-    return make_token(TOKEN_ERROR, "Unterminated string", lexer);
-} 
\ No newline at end of file
+    lexer->error = "Unterminated string";
+    token.type = TOKEN_ERROR;
+    return token;
+}
@@ -5,6 +5,7 @@
 #include "lexer.h"
 #include "parser.h"
 #include "vm.h"
+#include "source.h"
 
 // Function to print usage information
 void print_usage() {
@@ -16,30 +17,37 @@ void print_usage() {
     printf("  terminal             - Start interactive terminal\n");
 }
 
-// Function to read file contents
-char* read_file(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Could not open file '%s'\n", filename);
-        return NULL;
-    }
+// Stream a file's tokens to stdout through a sliding mapped window
+static int dump_tokens(const char* filename) {
+    SourceStream stream;
+    if (!open_source_stream(filename, SOURCE_WINDOW_SIZE, &stream)) return 1;
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    rewind(file);
+    Token token;
+    do {
+        token = source_stream_next(&stream);
+        printf("%d:%d %d '%.*s'\n", token.line, token.column, token.type,
+               token.length, token_start(&stream.lexer, &token));
+    } while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR);
 
-    char* buffer = (char*)malloc(size + 1);
-    if (!buffer) {
-        fclose(file);
-        fprintf(stderr, "Error: Memory allocation failed\n");
-        return NULL;
+    if (token.type == TOKEN_ERROR && stream.lexer.error) {
+        fprintf(stderr, "Error: %s at line %d\n", stream.lexer.error, token.line);
     }
+    close_source_stream(&stream);
+    return token.type == TOKEN_ERROR ? 65 : 0;
+}
 
-    size_t read_size = fread(buffer, 1, size, file);
-    buffer[read_size] = '\0';
-    fclose(file);
-
-    return buffer;
+// Run a file. Each top-level statement is compiled and executed as soon as
+// it is parsed, and function bodies are parsed on first call, so the first
+// statement runs before the rest of the file is read.
+static int run_file(VM* vm, const char* filename) {
+    Source source;
+    if (!load_source(filename, &source)) return 1;
+
+    InterpretResult result = interpret(vm, source.data, source.length);
+    release_source(&source);
+    if (result == INTERPRET_COMPILE_ERROR) return 65;
+    if (result == INTERPRET_RUNTIME_ERROR) return 70;
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -49,6 +57,10 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "  compile <input> <output>  Compile ibery++ source to bytecode\n");
         fprintf(stderr, "  run <input>              Run ibery++ source directly\n");
         fprintf(stderr, "  disassemble <input>      Show bytecode for ibery++ source\n");
+        fprintf(stderr, "  run-registers <input>    Run ibery++ source on the register tier\n");
+        fprintf(stderr, "  disassemble-registers <input>  Show register code for ibery++ source\n");
+        fprintf(stderr, "  run-flat <input>         Run ibery++ source on the flat tree walker\n");
+        fprintf(stderr, "  tokens <input>           Show the token stream of ibery++ source\n");
         return 1;
     }
 
@@ -62,13 +74,12 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        char* source = read_file(argv[2]);
-        if (!source) return 1;
+        Source source;
+        if (!load_source(argv[2], &source)) return 1;
 
         // Compile to bytecode
-        compile(&vm, source);
-        if (vm.parser->hadError) {
-            free(source);
+        if (!compile(&vm, source.data)) {
+            release_source(&source);
             return 1;
         }
 
@@ -76,13 +87,14 @@ int main(int argc, char* argv[]) {
         FILE* out = fopen(argv[3], "wb");
         if (!out) {
             fprintf(stderr, "Could not open output file.\n");
-            free(source);
+            release_source(&source);
             return 1;
         }
 
-        write_chunk(out, vm.chunk);
+        write_chunk(out, vm.chunk, vm.symbols.names, vm.symbols.count);
         fclose(out);
-        free(source);
+        release_source(&source);
+        freeVM(&vm);
         printf("Compiled successfully to %s\n", argv[3]);
         return 0;
     }
@@ -92,32 +104,81 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        char* source = read_file(argv[2]);
-        if (!source) return 1;
+        int status = run_file(&vm, argv[2]);
+        freeVM(&vm);
+        return status;
+    }
+    else if (strcmp(command, "disassemble") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s disassemble <input>\n", argv[0]);
+            return 1;
+        }
 
-        InterpretResult result = interpret(&vm, source);
-        free(source);
+        Source source;
+        if (!load_source(argv[2], &source)) return 1;
 
-        if (result == INTERPRET_COMPILE_ERROR) return 65;
-        if (result == INTERPRET_RUNTIME_ERROR) return 70;
+        if (compile(&vm, source.data)) {
+            disassemble_chunk(vm.chunk, "code", vm.symbols.names);
+        }
+        release_source(&source);
+        freeVM(&vm);
         return 0;
     }
-    else if (strcmp(command, "disassemble") == 0) {
+    else if (strcmp(command, "run-registers") == 0) {
         if (argc != 3) {
-            fprintf(stderr, "Usage: %s disassemble <input>\n", argv[0]);
+            fprintf(stderr, "Usage: %s run-registers <input>\n", argv[0]);
+            return 1;
+        }
+
+        Source source;
+        if (!load_source(argv[2], &source)) return 1;
+
+        int status = 65;
+        if (compile_registers(&vm, source.data)) {
+            InterpretResult result = run_register_chunk(&vm, vm.register_chunk);
+            status = result == INTERPRET_OK ? 0 : result == INTERPRET_COMPILE_ERROR ? 65 : 70;
+        }
+        release_source(&source);
+        freeVM(&vm);
+        return status;
+    }
+    else if (strcmp(command, "disassemble-registers") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s disassemble-registers <input>\n", argv[0]);
             return 1;
         }
 
-        char* source = read_file(argv[2]);
-        if (!source) return 1;
+        Source source;
+        if (!load_source(argv[2], &source)) return 1;
 
-        compile(&vm, source);
-        if (!vm.parser->hadError) {
-            disassemble_chunk(vm.chunk, "code");
+        if (compile_registers(&vm, source.data)) {
+            disassemble_register_chunk(vm.register_chunk, "code", vm.symbols.names);
         }
-        free(source);
+        release_source(&source);
+        freeVM(&vm);
         return 0;
     }
+    else if (strcmp(command, "run-flat") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s run-flat <input>\n", argv[0]);
+            return 1;
+        }
+
+        Source source;
+        if (!load_source(argv[2], &source)) return 1;
+
+        InterpretResult result = interpret_flat(&vm, source.data);
+        release_source(&source);
+        freeVM(&vm);
+        return result == INTERPRET_OK ? 0 : result == INTERPRET_COMPILE_ERROR ? 65 : 70;
+    }
+    else if (strcmp(command, "tokens") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s tokens <input>\n", argv[0]);
+            return 1;
+        }
+        return dump_tokens(argv[2]);
+    }
     else {
         fprintf(stderr, "Unknown command: %s\n", command);
         return 1;
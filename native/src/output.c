@@ -0,0 +1,102 @@
+#include "output.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+void init_output(Output* output, int fd, size_t capacity) {
+    output->fd = fd;
+    output->data = NULL;
+    output->length = 0;
+    output->capacity = 0;
+    output->line_buffered = isatty(fd);
+    set_output_buffer_size(output, capacity);
+}
+
+void free_output(Output* output) {
+    flush_output(output);
+    free(output->data);
+    output->data = NULL;
+    output->capacity = 0;
+}
+
+void set_output_buffer_size(Output* output, size_t capacity) {
+    flush_output(output);
+    free(output->data);
+    output->data = NULL;
+    if (capacity > 0) {
+        output->data = (char*)malloc(capacity);
+        if (!output->data) {
+            fprintf(stderr, "Failed to allocate output buffer\n");
+            exit(1);
+        }
+    }
+    output->capacity = capacity;
+}
+
+// Write every byte of iov, resuming after short writes
+static bool write_all(Output* output, struct iovec* iov, int count) {
+    // Anything printed through stdio on the same descriptor goes first
+    if (output->fd == STDOUT_FILENO) fflush(stdout);
+
+    while (count > 0) {
+        ssize_t written = writev(output->fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+bool flush_output(Output* output) {
+    if (output->length == 0) return true;
+    struct iovec iov = {output->data, output->length};
+    output->length = 0;
+    return write_all(output, &iov, 1);
+}
+
+// Text that does not fit goes out together with the buffer in one writev
+void output_write(Output* output, const char* data, size_t length) {
+    if (output->length + length <= output->capacity) {
+        memcpy(output->data + output->length, data, length);
+        output->length += length;
+        return;
+    }
+
+    struct iovec iov[2] = {
+        {output->data, output->length},
+        {(char*)data, length},
+    };
+    output->length = 0;
+    write_all(output, iov, 2);
+}
+
+void output_line(Output* output, const char* data, size_t length) {
+    if (output->length + length + 1 <= output->capacity) {
+        memcpy(output->data + output->length, data, length);
+        output->length += length;
+        output->data[output->length++] = '\n';
+        if (output->line_buffered) flush_output(output);
+        return;
+    }
+
+    struct iovec iov[3] = {
+        {output->data, output->length},
+        {(char*)data, length},
+        {"\n", 1},
+    };
+    output->length = 0;
+    write_all(output, iov, 3);
+}
@@ -4,8 +4,13 @@
 #include <string.h>
 #include "lexer.h"
 
+#define AST_ARENA_BLOCK_SIZE (64 * 1024)
+#define PARALLEL_PARSE_MIN_FUNCTIONS 8
+#define PARALLEL_PARSE_BATCHES_PER_THREAD 4
+
 // Forward declarations
 static ASTNode* parse_primary(Parser* parser);
+static ASTNode* parse_unary(Parser* parser);
 static ASTNode* parse_statement(Parser* parser);
 static ASTNode* parse_function_definition(Parser* parser);
 static ASTNode* parse_text_statement(Parser* parser);
@@ -13,12 +18,34 @@ static ASTNode* parse_game_engine(Parser* parser);
 
 // Helper functions
 static void parser_advance(Parser* parser) {
+    if (parser->tokens) {
+        if (parser->token_index < parser->tokens->count - 1) parser->token_index++;
+        parser->current = token_at(parser->tokens, parser->token_index);
+        return;
+    }
     parser->current = get_next_token(parser->lexer);
 }
 
+// Type of the token distance places after current, without consuming it
+static TokenType peek_type(Parser* parser, int distance) {
+    if (parser->tokens) {
+        int index = parser->token_index + distance;
+        if (index >= parser->tokens->count) index = parser->tokens->count - 1;
+        return (TokenType)parser->tokens->types[index];
+    }
+    
+    // Streaming mode: lex ahead on a copy of the lexer state
+    Lexer ahead = *parser->lexer;
+    Token token = parser->current;
+    for (int i = 0; i < distance && token.type != TOKEN_EOF; i++) {
+        token = get_next_token(&ahead);
+    }
+    return token.type;
+}
+
 static void expect(Parser* parser, TokenType type) {
     if (parser->current.type != type) {
-        fprintf(stderr, "Expected token type %d but got %d\n", type, parser->current.type);
+        fprintf(parser->errors, "Expected token type %d but got %d\n", type, parser->current.type);
         parser->had_error = 1;
         return;
     }
@@ -26,57 +53,337 @@ static void expect(Parser* parser, TokenType type) {
 }
 
 // Create a new parser
-Parser* create_parser(Lexer* lexer) {
+Parser* create_parser(Lexer* lexer, Interner* strings) {
     Parser* parser = (Parser*)malloc(sizeof(Parser));
     if (!parser) {
         fprintf(stderr, "Failed to allocate memory for parser\n");
         return NULL;
     }
     parser->lexer = lexer;
+    parser->strings = strings;
     parser->had_error = 0;
+    parser->tokens = NULL;
+    parser->token_index = 0;
+    parser->arena = NULL;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->lazy_functions = false;
+    parser->pool = NULL;
+    parser->errors = stderr;
     parser_advance(parser); // Load first token
     return parser;
 }
 
+// Create a parser that lexes the whole source up front
+Parser* create_buffered_parser(Lexer* lexer, Interner* strings) {
+    return create_parser_from_tokens(lexer, tokenize(lexer), strings);
+}
+
+// Create a parser over an already lexed token buffer (e.g. from
+// tokenize_parallel); the parser takes ownership of tokens
+Parser* create_parser_from_tokens(Lexer* lexer, TokenBuffer* tokens, Interner* strings) {
+    Parser* parser = (Parser*)malloc(sizeof(Parser));
+    if (!parser) {
+        fprintf(stderr, "Failed to allocate memory for parser\n");
+        free_token_buffer(tokens);
+        return NULL;
+    }
+    parser->lexer = lexer;
+    parser->strings = strings;
+    parser->had_error = 0;
+    parser->tokens = tokens;
+    parser->token_index = 0;
+    parser->arena = NULL;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->lazy_functions = false;
+    parser->pool = NULL;
+    parser->errors = stderr;
+    parser->current = token_at(parser->tokens, 0);
+    return parser;
+}
+
 // Free parser memory
 void free_parser(Parser* parser) {
     if (parser) {
+        free_token_buffer(parser->tokens);
+        free(parser->scratch);
         free(parser);
     }
 }
 
-// Create a new AST node
-static ASTNode* create_node(NodeType type) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        fprintf(stderr, "Failed to allocate memory for AST node\n");
-        exit(1);
-    }
+// Create a new AST node in the parser's arena
+static ASTNode* create_node(Parser* parser, NodeType type) {
+    ASTNode* node = (ASTNode*)arena_alloc(parser->arena, sizeof(ASTNode));
     node->type = type;
+    node->line = parser->current.line;
     memset(&node->data, 0, sizeof(node->data));
     return node;
 }
 
-// Parse a program (sequence of statements)
-ASTNode* parse_program(Parser* parser) {
-    ASTNode* program = create_node(NODE_PROGRAM);
-    program->data.program.statements = NULL;
-    program->data.program.statement_count = 0;
+// Push a node onto the scratch stack used to collect statement and
+// animation lists while they are being parsed
+static void scratch_push(Parser* parser, ASTNode* node) {
+    if (parser->scratch_count >= parser->scratch_capacity) {
+        parser->scratch_capacity = parser->scratch_capacity < 64 ? 64 : parser->scratch_capacity * 2;
+        parser->scratch = (ASTNode**)realloc(parser->scratch, parser->scratch_capacity * sizeof(ASTNode*));
+        if (!parser->scratch) {
+            fprintf(stderr, "Failed to grow parser scratch stack\n");
+            exit(1);
+        }
+    }
+    parser->scratch[parser->scratch_count++] = node;
+}
 
-    while (!parser->had_error && parser->current.type != TOKEN_EOF) {
+// Move the scratch entries above base into an exactly sized arena array
+static ASTNode** scratch_pop_list(Parser* parser, int base, int* count) {
+    *count = parser->scratch_count - base;
+    ASTNode** list = NULL;
+    if (*count > 0) {
+        list = (ASTNode**)arena_alloc(parser->arena, *count * sizeof(ASTNode*));
+        memcpy(list, parser->scratch + base, *count * sizeof(ASTNode*));
+    }
+    parser->scratch_count = base;
+    return list;
+}
+
+// Parse statements up to EOF or a closing brace, passing each one to
+// handler (if any) as soon as it is complete
+static ASTNode* parse_statements(Parser* parser, StatementHandler handler, void* arg) {
+    ASTNode* program = create_node(parser, NODE_PROGRAM);
+    int base = parser->scratch_count;
+
+    while (!parser->had_error &&
+           parser->current.type != TOKEN_EOF &&
+           parser->current.type != TOKEN_RBRACE) {
         ASTNode* statement = parse_statement(parser);
         if (!statement) break;
+        scratch_push(parser, statement);
+        if (handler) handler(statement, arg);
+    }
+
+    program->data.program.statements =
+        scratch_pop_list(parser, base, &program->data.program.statement_count);
+    return program;
+}
+
+static ASTNode* parse_block(Parser* parser) {
+    return parse_statements(parser, NULL, NULL);
+}
+
+// A top-level function definition parsed ahead of time by a worker
+typedef struct {
+    int start;               // Token index of 'function'
+    int end;                 // Token index just after the definition
+    ASTNode* node;
+    bool parsed;             // The worker got to this definition
+    bool failed;             // Its batch's diagnostics belong to this one
+    int batch;
+} ParsedFunction;
+
+// A run of top-level definitions parsed by one worker with its own parser
+// state, arena and diagnostics buffer
+typedef struct {
+    Parser parser;
+    ParsedFunction* functions;
+    int first;
+    int count;
+    char* errors;
+    size_t errors_size;
+} ParseBatch;
+
+// Token indices of 'function' keywords at brace depth 0, up to EOF or a
+// stray '}'. Some may not start a statement if the program has an error
+// earlier on; those are simply never used.
+static ParsedFunction* find_top_level_functions(const TokenBuffer* tokens, int start, int* count) {
+    ParsedFunction* functions = NULL;
+    int capacity = 0;
+    int depth = 0;
+    *count = 0;
+
+    for (int i = start; i < tokens->count; i++) {
+        TokenType type = (TokenType)tokens->types[i];
+        if (type == TOKEN_LBRACE) {
+            depth++;
+        } else if (type == TOKEN_RBRACE) {
+            if (depth == 0) break;
+            depth--;
+        } else if (type == TOKEN_FUNCTION && depth == 0) {
+            if (*count >= capacity) {
+                capacity = capacity < 64 ? 64 : capacity * 2;
+                functions = (ParsedFunction*)realloc(functions, capacity * sizeof(ParsedFunction));
+                if (!functions) {
+                    fprintf(stderr, "Failed to allocate memory for parallel parse\n");
+                    exit(1);
+                }
+            }
+            ParsedFunction* function = &functions[(*count)++];
+            memset(function, 0, sizeof(*function));
+            function->start = i;
+        }
+    }
+    return functions;
+}
+
+// Worker: parse each definition in the batch exactly as the serial parser
+// would from that token, stopping at the first syntax error
+static void parse_batch(void* arg) {
+    ParseBatch* batch = (ParseBatch*)arg;
+    Parser* parser = &batch->parser;
+    parser->errors = open_memstream(&batch->errors, &batch->errors_size);
+    if (!parser->errors) {
+        fprintf(stderr, "Failed to allocate memory for parser diagnostics\n");
+        exit(1);
+    }
+
+    for (int i = batch->first; i < batch->first + batch->count; i++) {
+        ParsedFunction* function = &batch->functions[i];
+        parser->token_index = function->start;
+        parser->current = token_at(parser->tokens, function->start);
+        function->node = parse_statement(parser);
+        function->end = parser->token_index;
+        function->parsed = true;
+        function->failed = parser->had_error;
+        if (parser->had_error) break;
+    }
+    fclose(parser->errors);
+}
+
+// Top-level statement list with the function definitions parsed on the
+// pool. The merge walks the program serially, taking each definition from
+// its worker when it reaches it, so the tree and diagnostics are the same as
+// parse_block's.
+static ASTNode* parse_block_parallel(Parser* parser) {
+    int function_count;
+    ParsedFunction* functions = find_top_level_functions(parser->tokens, parser->token_index, &function_count);
+    if (function_count < PARALLEL_PARSE_MIN_FUNCTIONS) {
+        free(functions);
+        return parse_block(parser);
+    }
+
+    int batch_count = thread_pool_size(parser->pool) * PARALLEL_PARSE_BATCHES_PER_THREAD;
+    if (batch_count > function_count) batch_count = function_count;
+    ParseBatch* batches = (ParseBatch*)calloc(batch_count, sizeof(ParseBatch));
+    if (!batches) {
+        fprintf(stderr, "Failed to allocate memory for parallel parse\n");
+        exit(1);
+    }
+
+    // Workers intern into the shared table under a lock
+    pthread_mutex_t strings_lock;
+    pthread_mutex_init(&strings_lock, NULL);
+    parser->strings->lock = &strings_lock;
+
+    // Give each batch a run of definitions covering about the same number
+    // of tokens
+    int first_token = functions[0].start;
+    int span = parser->tokens->count - first_token;
+    int next = 0;
+    for (int b = 0; b < batch_count; b++) {
+        ParseBatch* batch = &batches[b];
+        batch->parser = *parser;
+        batch->parser.arena = create_arena(AST_ARENA_BLOCK_SIZE);
+        batch->parser.scratch = NULL;
+        batch->parser.scratch_count = 0;
+        batch->parser.scratch_capacity = 0;
+        batch->parser.pool = NULL;
+        batch->functions = functions;
+        batch->first = next;
+
+        int limit = first_token + (int)((long long)span * (b + 1) / batch_count);
+        while (next < function_count && (next == batch->first || functions[next].start < limit)) {
+            functions[next++].batch = b;
+        }
+        if (b == batch_count - 1) {
+            while (next < function_count) functions[next++].batch = b;
+        }
+        batch->count = next - batch->first;
+        thread_pool_submit(parser->pool, parse_batch, batch);
+    }
+    thread_pool_wait(parser->pool);
+    parser->strings->lock = NULL;
+    pthread_mutex_destroy(&strings_lock);
+
+    ASTNode* program = create_node(parser, NODE_PROGRAM);
+    int base = parser->scratch_count;
+    int next_function = 0;
+
+    while (!parser->had_error &&
+           parser->current.type != TOKEN_EOF &&
+           parser->current.type != TOKEN_RBRACE) {
+        while (next_function < function_count &&
+               functions[next_function].start < parser->token_index) {
+            next_function++;
+        }
+
+        ASTNode* statement;
+        ParsedFunction* function = next_function < function_count ? &functions[next_function] : NULL;
+        if (function && function->parsed && function->start == parser->token_index) {
+            if (function->failed) {
+                ParseBatch* batch = &batches[function->batch];
+                fwrite(batch->errors, 1, batch->errors_size, parser->errors);
+                parser->had_error = 1;
+            }
+            statement = function->node;
+            parser->token_index = function->end;
+            parser->current = token_at(parser->tokens, function->end);
+        } else {
+            statement = parse_statement(parser);
+        }
+        if (!statement) break;
+        scratch_push(parser, statement);
+    }
+
+    program->data.program.statements =
+        scratch_pop_list(parser, base, &program->data.program.statement_count);
 
-        // Add statement to program
-        program->data.program.statement_count++;
-        program->data.program.statements = realloc(program->data.program.statements,
-            program->data.program.statement_count * sizeof(ASTNode*));
-        program->data.program.statements[program->data.program.statement_count - 1] = statement;
+    for (int b = 0; b < batch_count; b++) {
+        arena_adopt(parser->arena, batches[b].parser.arena);
+        free(batches[b].parser.scratch);
+        free(batches[b].errors);
     }
+    free(batches);
+    free(functions);
+    return program;
+}
 
+// Parse a program (sequence of statements).
+// The whole tree is allocated from one arena owned by the returned root, so
+// free_ast on the root releases everything in a single step. Buffered
+// parsers with a pool parse top-level functions in parallel; lazy parsers
+// skip bodies anyway, so they always run serially.
+static ASTNode* finish_program(Parser* parser, ASTNode* program) {
+    if (!parser->had_error && parser->current.type != TOKEN_EOF) {
+        fprintf(parser->errors, "Unexpected '}' at line %d\n", parser->current.line);
+        parser->had_error = 1;
+    }
+    program->data.program.arena = parser->arena;
+    parser->arena = NULL;
     return program;
 }
 
+ASTNode* parse_program(Parser* parser) {
+    parser->arena = create_arena(AST_ARENA_BLOCK_SIZE);
+    ASTNode* program = parser->pool && parser->tokens && !parser->lazy_functions
+        ? parse_block_parallel(parser)
+        : parse_block(parser);
+    return finish_program(parser, program);
+}
+
+// Parse a program, handing each top-level statement to handler as soon as
+// it has been parsed. With a streaming (unbuffered) parser only the tokens
+// of the current statement have been lexed when handler runs, so work such
+// as execution starts before the rest of the file is read. The returned
+// tree holds every statement and must be freed as usual; statements already
+// handled stay valid in it. Always serial.
+ASTNode* parse_program_streaming(Parser* parser, StatementHandler handler, void* arg) {
+    parser->arena = create_arena(AST_ARENA_BLOCK_SIZE);
+    ASTNode* program = parse_statements(parser, handler, arg);
+    return finish_program(parser, program);
+}
+
 // Parse a statement
 static ASTNode* parse_statement(Parser* parser) {
     switch (parser->current.type) {
@@ -91,20 +398,95 @@ static ASTNode* parse_statement(Parser* parser) {
             if (!node) return NULL;
             
             expect(parser, TOKEN_SEMICOLON);
-            if (parser->had_error) {
-                free_ast(node);
-                return NULL;
-            }
+            if (parser->had_error) return NULL;
             return node;
         }
         case TOKEN_GAME_ENGINE:
             parser_advance(parser);
             return parse_game_engine(parser);
         default:
-            fprintf(stderr, "Unexpected token in statement\n");
+            fprintf(parser->errors, "Unexpected token in statement\n");
+            parser->had_error = 1;
+            return NULL;
+    }
+}
+
+// Skip a function body up to its matching closing brace and record where
+// it is, so it can be parsed on first call. Only braces are counted; the
+// body's own syntax errors are reported when it is parsed.
+static LazyBody* skip_function_body(Parser* parser) {
+    Token first = parser->current;
+    int depth = 0;
+
+    if (parser->tokens) {
+        // Scan the buffered types directly rather than rebuilding every
+        // token; the last entry is EOF or an error and ends the scan
+        const uint8_t* types = parser->tokens->types;
+        int last = parser->tokens->count - 1;
+        int index = parser->token_index;
+        while (index < last && (types[index] != TOKEN_RBRACE || depth > 0)) {
+            if (types[index] == TOKEN_LBRACE) depth++;
+            if (types[index] == TOKEN_RBRACE) depth--;
+            index++;
+        }
+        parser->token_index = index;
+        parser->current = token_at(parser->tokens, index);
+        if (parser->current.type != TOKEN_RBRACE) {
+            fprintf(parser->errors, "Unterminated function body starting at line %d\n", first.line);
             parser->had_error = 1;
             return NULL;
+        }
     }
+
+    while (parser->current.type != TOKEN_RBRACE || depth > 0) {
+        if (parser->current.type == TOKEN_EOF) {
+            fprintf(parser->errors, "Unterminated function body starting at line %d\n", first.line);
+            parser->had_error = 1;
+            return NULL;
+        }
+        if (parser->current.type == TOKEN_LBRACE) depth++;
+        if (parser->current.type == TOKEN_RBRACE) depth--;
+        parser_advance(parser);
+    }
+    
+    LazyBody* lazy = (LazyBody*)arena_alloc(parser->arena, sizeof(LazyBody));
+    lazy->source = token_start(parser->lexer, &first);
+    lazy->length = parser->current.offset - first.offset;
+    lazy->line = first.line;
+    lazy->column = first.column;
+    lazy->arena = parser->arena;
+    lazy->strings = parser->strings;
+    return lazy;
+}
+
+ASTNode* parse_function_body(ASTNode* function) {
+    LazyBody* lazy = function->data.function_definition.lazy;
+    if (function->data.function_definition.body || !lazy) {
+        return function->data.function_definition.body;
+    }
+    
+    Lexer lexer;
+    init_lexer(&lexer, lazy->source, lazy->length);
+    lexer.line = lazy->line;
+    lexer.column = lazy->column;
+    
+    Parser* parser = create_parser(&lexer, lazy->strings);
+    if (!parser) return NULL;
+    parser->lazy_functions = true;
+    parser->arena = lazy->arena;
+    
+    ASTNode* body = parse_block(parser);
+    if (!parser->had_error && parser->current.type != TOKEN_EOF) {
+        fprintf(parser->errors, "Unexpected '}' at line %d\n", parser->current.line);
+        parser->had_error = 1;
+    }
+    if (!parser->had_error) {
+        function->data.function_definition.body = body;
+    }
+    
+    parser->arena = NULL;
+    free_parser(parser);
+    return function->data.function_definition.body;
 }
 
 // Parse a function definition
@@ -112,32 +494,31 @@ static ASTNode* parse_function_definition(Parser* parser) {
     parser_advance(parser); // Consume 'function'
     
     if (parser->current.type != TOKEN_IDENTIFIER) {
-        fprintf(stderr, "Expected function name\n");
+        fprintf(parser->errors, "Expected function name\n");
         parser->had_error = 1;
         return NULL;
     }
     
-    ASTNode* node = create_node(NODE_FUNCTION_DEFINITION);
-    node->data.function_definition.name = strdup(parser->current.value.string_val);
+    ASTNode* node = create_node(parser, NODE_FUNCTION_DEFINITION);
+    node->data.function_definition.name = token_intern(parser->lexer, &parser->current, parser->strings);
+    node->data.function_definition.slot = -1;
     parser_advance(parser);
     
     expect(parser, TOKEN_LBRACE);
     if (parser->had_error) {
-        free(node->data.function_definition.name);
-        free(node);
         return NULL;
     }
     
-    // Parse function body
-    node->data.function_definition.body = parse_program(parser);
+    // Parse function body, or just find its end in lazy mode
+    if (parser->lazy_functions) {
+        node->data.function_definition.lazy = skip_function_body(parser);
+        if (parser->had_error) return NULL;
+    } else {
+        node->data.function_definition.body = parse_block(parser);
+    }
     
     expect(parser, TOKEN_RBRACE);
-    if (parser->had_error) {
-        free_ast(node->data.function_definition.body);
-        free(node->data.function_definition.name);
-        free(node);
-        return NULL;
-    }
+    if (parser->had_error) return NULL;
     
     return node;
 }
@@ -146,21 +527,18 @@ static ASTNode* parse_function_definition(Parser* parser) {
 static ASTNode* parse_text_statement(Parser* parser) {
     parser_advance(parser); // Consume 'text'
     
-    if (parser->current.type != TOKEN_STRING) {
-        fprintf(stderr, "Expected string after 'text'\n");
-        parser->had_error = 1;
-        return NULL;
-    }
+    ASTNode* expr = parse_expression(parser);
+    if (!expr) return NULL;
     
-    ASTNode* node = create_node(NODE_TEXT);
-    node->data.text.content = strdup(parser->current.value.string_val);
-    parser_advance(parser);
+    // A literal (or an expression folded down to one) is kept as content
+    ASTNode* node = create_node(parser, NODE_TEXT);
+    node->data.text.expr = expr;
+    if (expr->type == NODE_STRING_LITERAL) {
+        node->data.text.content = expr->data.string_literal.value;
+    }
     
     expect(parser, TOKEN_SEMICOLON);
-    if (parser->had_error) {
-        free_ast(node);
-        return NULL;
-    }
+    if (parser->had_error) return NULL;
     
     return node;
 }
@@ -172,61 +550,72 @@ static ASTNode* parse_primary(Parser* parser) {
     
     switch (token.type) {
         case TOKEN_STRING: {
-            ASTNode* node = create_node(NODE_STRING_LITERAL);
-            node->data.string_literal.value = strdup(token.value.string_val);
+            ASTNode* node = create_node(parser, NODE_STRING_LITERAL);
+            node->data.string_literal.value = token_intern(parser->lexer, &token, parser->strings);
             return node;
         }
         case TOKEN_NUMBER: {
-            ASTNode* node = create_node(NODE_NUMBER);
-            node->data.number.value = token.value.number_val;
+            ASTNode* node = create_node(parser, NODE_NUMBER);
+            node->data.number.value = token_number(parser->lexer, &token);
+            return node;
+        }
+        case TOKEN_TRUE:
+        case TOKEN_FALSE: {
+            ASTNode* node = create_node(parser, NODE_BOOLEAN);
+            node->data.boolean.value = token.type == TOKEN_TRUE;
+            return node;
+        }
+        case TOKEN_LPAREN: {
+            ASTNode* node = parse_expression(parser);
+            if (!node) return NULL;
+            expect(parser, TOKEN_RPAREN);
+            if (parser->had_error) return NULL;
             return node;
         }
         case TOKEN_INPUT: {
-            ASTNode* node = create_node(NODE_INPUT);
+            ASTNode* node = create_node(parser, NODE_INPUT);
             expect(parser, TOKEN_LBRACE);
             if (parser->had_error) {
-                free(node);
                 return NULL;
             }
             
             if (parser->current.type != TOKEN_STRING) {
-                fprintf(stderr, "Expected string in input statement\n");
+                fprintf(parser->errors, "Expected string in input statement\n");
                 parser->had_error = 1;
-                free(node);
                 return NULL;
             }
             
-            node->data.input.prompt = strdup(parser->current.value.string_val);
+            node->data.input.prompt = token_intern(parser->lexer, &parser->current, parser->strings);
             parser_advance(parser);
             
             expect(parser, TOKEN_RBRACE);
             if (parser->had_error) {
-                free(node->data.input.prompt);
-                free(node);
                 return NULL;
             }
             
             return node;
         }
         case TOKEN_IDENTIFIER: {
-            if (parser->current.type == TOKEN_LBRACE) {
-                parser_advance(parser);
-                if (parser->current.type == TOKEN_NUM) {
-                    parser_advance(parser);
-                    expect(parser, TOKEN_RBRACE);
-                    if (parser->had_error) return NULL;
-                    
-                    ASTNode* node = create_node(NODE_NUMBER_CONVERSION);
-                    node->data.number_conversion.expr = parse_expression(parser);
-                    return node;
-                }
+            // IDENTIFIER {num} is a number conversion; anything else leaves
+            // the brace for the caller
+            if (parser->current.type == TOKEN_LBRACE &&
+                peek_type(parser, 1) == TOKEN_NUM &&
+                peek_type(parser, 2) == TOKEN_RBRACE) {
+                parser_advance(parser); // Consume '{'
+                parser_advance(parser); // Consume 'num'
+                parser_advance(parser); // Consume '}'
+                
+                ASTNode* node = create_node(parser, NODE_NUMBER_CONVERSION);
+                node->data.number_conversion.expr = parse_expression(parser);
+                return node;
             }
-            ASTNode* node = create_node(NODE_IDENTIFIER);
-            node->data.identifier.name = strdup(token.value.string_val);
+            ASTNode* node = create_node(parser, NODE_IDENTIFIER);
+            node->data.identifier.name = token_intern(parser->lexer, &token, parser->strings);
+            node->data.identifier.slot = -1;
             return node;
         }
         default:
-            fprintf(stderr, "Unexpected token in primary expression\n");
+            fprintf(parser->errors, "Unexpected token in primary expression\n");
             parser->had_error = 1;
             return NULL;
     }
@@ -234,162 +623,274 @@ static ASTNode* parse_primary(Parser* parser) {
 
 // Parse a game engine statement
 static ASTNode* parse_game_engine(Parser* parser) {
-    ASTNode* node = create_node(NODE_GAME_ENGINE);
+    ASTNode* node = create_node(parser, NODE_GAME_ENGINE);
     
     expect(parser, TOKEN_LBRACE);
     if (parser->had_error) {
-        free(node);
         return NULL;
     }
     
     // Parse the expression first
     node->data.game_engine.expr = parse_expression(parser);
     if (!node->data.game_engine.expr) {
-        free(node);
         return NULL;
     }
     
-    // Initialize animations array
-    node->data.game_engine.animations = NULL;
-    node->data.game_engine.animation_count = 0;
-    
     // Parse animations if they exist
+    int base = parser->scratch_count;
     while (parser->current.type != TOKEN_RBRACE && !parser->had_error) {
         ASTNode* animation = parse_animation(parser);
-        if (!animation) {
-            // Free any previously allocated animations
-            for (int i = 0; i < node->data.game_engine.animation_count; i++) {
-                free_ast(node->data.game_engine.animations[i]);
-            }
-            free(node->data.game_engine.animations);
-            free_ast(node->data.game_engine.expr);
-            free(node);
-            return NULL;
-        }
-        
-        // Add animation to the list
-        node->data.game_engine.animation_count++;
-        node->data.game_engine.animations = realloc(node->data.game_engine.animations, 
-            node->data.game_engine.animation_count * sizeof(ASTNode*));
-        node->data.game_engine.animations[node->data.game_engine.animation_count - 1] = animation;
+        if (!animation) break;
+        scratch_push(parser, animation);
     }
+    node->data.game_engine.animations =
+        scratch_pop_list(parser, base, &node->data.game_engine.animation_count);
+    if (parser->had_error) return NULL;
     
     expect(parser, TOKEN_RBRACE);
-    if (parser->had_error) {
-        // Free all animations and expression
-        for (int i = 0; i < node->data.game_engine.animation_count; i++) {
-            free_ast(node->data.game_engine.animations[i]);
-        }
-        free(node->data.game_engine.animations);
-        free_ast(node->data.game_engine.expr);
-        free(node);
-        return NULL;
-    }
+    if (parser->had_error) return NULL;
     
     return node;
 }
 
 // Add parse_animation function
 static ASTNode* parse_animation(Parser* parser) {
-    ASTNode* node = create_node(NODE_ANIMATION);
+    ASTNode* node = create_node(parser, NODE_ANIMATION);
     
     // Parse emoji
     if (parser->current.type != TOKEN_STRING) {
-        fprintf(stderr, "Expected emoji string\n");
+        fprintf(parser->errors, "Expected emoji string\n");
         parser->had_error = 1;
-        free(node);
         return NULL;
     }
-    node->data.animation.emoji = strdup(parser->current.value.string_val);
+    node->data.animation.emoji = token_intern(parser->lexer, &parser->current, parser->strings);
     parser_advance(parser);
     
     // Parse action
     if (parser->current.type != TOKEN_STRING) {
-        fprintf(stderr, "Expected action string\n");
+        fprintf(parser->errors, "Expected action string\n");
         parser->had_error = 1;
-        free(node->data.animation.emoji);
-        free(node);
         return NULL;
     }
-    node->data.animation.action = strdup(parser->current.value.string_val);
+    node->data.animation.action = token_intern(parser->lexer, &parser->current, parser->strings);
     parser_advance(parser);
     
     // Parse distance
     if (parser->current.type != TOKEN_NUMBER) {
-        fprintf(stderr, "Expected distance number\n");
+        fprintf(parser->errors, "Expected distance number\n");
         parser->had_error = 1;
-        free(node->data.animation.emoji);
-        free(node->data.animation.action);
-        free(node);
         return NULL;
     }
-    node->data.animation.distance = parser->current.value.number_val;
+    node->data.animation.distance = token_number(parser->lexer, &parser->current);
     parser_advance(parser);
     
     // Parse repeat (optional)
     node->data.animation.repeat = 1; // Default value
     if (parser->current.type == TOKEN_NUMBER) {
-        node->data.animation.repeat = parser->current.value.number_val;
+        node->data.animation.repeat = token_number(parser->lexer, &parser->current);
         parser_advance(parser);
     }
     
     // Parse speed (optional)
     node->data.animation.speed = 1; // Default value
     if (parser->current.type == TOKEN_NUMBER) {
-        node->data.animation.speed = parser->current.value.number_val;
+        node->data.animation.speed = token_number(parser->lexer, &parser->current);
         parser_advance(parser);
     }
     
     return node;
 }
 
-// Parse an expression
-static ASTNode* parse_expression(Parser* parser) {
-    return parse_primary(parser);
+// Binding power of a binary operator, 0 if the token isn't one
+static int binary_precedence(TokenType type) {
+    switch (type) {
+        case TOKEN_EQ:
+        case TOKEN_NEQ:
+            return 1;
+        case TOKEN_LT:
+        case TOKEN_GT:
+        case TOKEN_LTE:
+        case TOKEN_GTE:
+            return 2;
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+            return 3;
+        case TOKEN_MULTIPLY:
+        case TOKEN_DIVIDE:
+            return 4;
+        default:
+            return 0;
+    }
 }
 
-// Free an AST node and its children
-void free_ast(ASTNode* node) {
-    if (!node) return;
+const char* operator_name(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: return "+";
+        case TOKEN_MINUS: return "-";
+        case TOKEN_MULTIPLY: return "*";
+        case TOKEN_DIVIDE: return "/";
+        case TOKEN_EQ: return "==";
+        case TOKEN_NEQ: return "!=";
+        case TOKEN_LT: return "<";
+        case TOKEN_GT: return ">";
+        case TOKEN_LTE: return "<=";
+        case TOKEN_GTE: return ">=";
+        case TOKEN_BANG: return "!";
+        default: return "?";
+    }
+}
+
+static bool is_constant(const ASTNode* node) {
+    return node->type == NODE_NUMBER ||
+           node->type == NODE_STRING_LITERAL ||
+           node->type == NODE_BOOLEAN;
+}
+
+// Only false is falsy among the literal types, matching the evaluator
+static bool constant_truthy(const ASTNode* node) {
+    return node->type != NODE_BOOLEAN || node->data.boolean.value;
+}
+
+// Equality of two literals; mixed types are never equal. Strings are
+// interned, so equal contents means the same handle.
+static bool constants_equal(const ASTNode* a, const ASTNode* b) {
+    if (a->type != b->type) return false;
+    switch (a->type) {
+        case NODE_NUMBER: return a->data.number.value == b->data.number.value;
+        case NODE_STRING_LITERAL: return a->data.string_literal.value == b->data.string_literal.value;
+        case NODE_BOOLEAN: return a->data.boolean.value == b->data.boolean.value;
+        default: return false;
+    }
+}
+
+static ASTNode* make_boolean(Parser* parser, bool value) {
+    ASTNode* node = create_node(parser, NODE_BOOLEAN);
+    node->data.boolean.value = value;
+    return node;
+}
+
+static ASTNode* make_number(Parser* parser, double value) {
+    ASTNode* node = create_node(parser, NODE_NUMBER);
+    node->data.number.value = value;
+    return node;
+}
+
+// Evaluate op over two literals at parse time.
+// Returns NULL when the operation has to wait for runtime (including the
+// type errors the evaluator reports), so folding never changes behaviour.
+static ASTNode* fold_binary(Parser* parser, TokenType op, const ASTNode* left, const ASTNode* right) {
+    if (op == TOKEN_EQ) return make_boolean(parser, constants_equal(left, right));
+    if (op == TOKEN_NEQ) return make_boolean(parser, !constants_equal(left, right));
     
-    switch (node->type) {
-        case NODE_PROGRAM:
-            for (int i = 0; i < node->data.program.statement_count; i++) {
-                free_ast(node->data.program.statements[i]);
-            }
-            free(node->data.program.statements);
-            break;
-        case NODE_FUNCTION_DEFINITION:
-            free(node->data.function_definition.name);
-            free_ast(node->data.function_definition.body);
-            break;
-        case NODE_TEXT:
-            free(node->data.text.content);
-            break;
-        case NODE_STRING_LITERAL:
-            free(node->data.string_literal.value);
-            break;
-        case NODE_IDENTIFIER:
-            free(node->data.identifier.name);
-            break;
-        case NODE_INPUT:
-            free(node->data.input.prompt);
-            break;
-        case NODE_NUMBER_CONVERSION:
-            free_ast(node->data.number_conversion.expr);
-            break;
-        case NODE_GAME_ENGINE:
-            free_ast(node->data.game_engine.expr);
-            for (int i = 0; i < node->data.game_engine.animation_count; i++) {
-                free_ast(node->data.game_engine.animations[i]);
-            }
-            free(node->data.game_engine.animations);
-            break;
-        default:
-            break;
+    if (left->type == NODE_STRING_LITERAL && right->type == NODE_STRING_LITERAL) {
+        if (op != TOKEN_PLUS) return NULL;
+        
+        // Concatenate into the interner, so the result is a plain literal
+        const char* a = left->data.string_literal.value;
+        const char* b = right->data.string_literal.value;
+        size_t a_length = interned_length(a);
+        size_t b_length = interned_length(b);
+        char* chars = (char*)malloc(a_length + b_length);
+        if (!chars) {
+            fprintf(stderr, "Failed to allocate memory for string constant\n");
+            exit(1);
+        }
+        memcpy(chars, a, a_length);
+        memcpy(chars + a_length, b, b_length);
+        
+        ASTNode* node = create_node(parser, NODE_STRING_LITERAL);
+        node->data.string_literal.value = intern(parser->strings, chars, a_length + b_length);
+        free(chars);
+        return node;
+    }
+    
+    if (left->type != NODE_NUMBER || right->type != NODE_NUMBER) return NULL;
+    double a = left->data.number.value;
+    double b = right->data.number.value;
+    switch (op) {
+        case TOKEN_PLUS: return make_number(parser, a + b);
+        case TOKEN_MINUS: return make_number(parser, a - b);
+        case TOKEN_MULTIPLY: return make_number(parser, a * b);
+        case TOKEN_DIVIDE: return make_number(parser, a / b);
+        case TOKEN_LT: return make_boolean(parser, a < b);
+        case TOKEN_GT: return make_boolean(parser, a > b);
+        case TOKEN_LTE: return make_boolean(parser, a <= b);
+        case TOKEN_GTE: return make_boolean(parser, a >= b);
+        default: return NULL;
+    }
+}
+
+// Build a binary node, or its value if both operands are literals
+static ASTNode* make_binary(Parser* parser, TokenType op, ASTNode* left, ASTNode* right) {
+    if (is_constant(left) && is_constant(right)) {
+        ASTNode* folded = fold_binary(parser, op, left, right);
+        if (folded) return folded;
     }
     
-    free(node);
+    ASTNode* node = create_node(parser, NODE_BINARY);
+    node->data.binary.op = op;
+    node->data.binary.left = left;
+    node->data.binary.right = right;
+    return node;
+}
+
+// Build a unary node, or its value if the operand is a literal
+static ASTNode* make_unary(Parser* parser, TokenType op, ASTNode* operand) {
+    if (op == TOKEN_BANG && is_constant(operand)) {
+        return make_boolean(parser, !constant_truthy(operand));
+    }
+    if (op == TOKEN_MINUS && operand->type == NODE_NUMBER) {
+        return make_number(parser, -operand->data.number.value);
+    }
+    
+    ASTNode* node = create_node(parser, NODE_UNARY);
+    node->data.unary.op = op;
+    node->data.unary.operand = operand;
+    return node;
+}
+
+// Parse '-' and '!' prefixes
+static ASTNode* parse_unary(Parser* parser) {
+    TokenType op = parser->current.type;
+    if (op != TOKEN_MINUS && op != TOKEN_BANG) {
+        return parse_primary(parser);
+    }
+    
+    parser_advance(parser);
+    ASTNode* operand = parse_unary(parser);
+    if (!operand) return NULL;
+    return make_unary(parser, op, operand);
+}
+
+// Precedence climbing: parse operators that bind at least as tightly as
+// min_precedence. All binary operators are left-associative.
+static ASTNode* parse_binary(Parser* parser, int min_precedence) {
+    ASTNode* left = parse_unary(parser);
+    
+    while (left) {
+        TokenType op = parser->current.type;
+        int precedence = binary_precedence(op);
+        if (precedence == 0 || precedence < min_precedence) break;
+        
+        parser_advance(parser);
+        ASTNode* right = parse_binary(parser, precedence + 1);
+        if (!right) return NULL;
+        left = make_binary(parser, op, left, right);
+    }
+    return left;
+}
+
+// Parse an expression
+static ASTNode* parse_expression(Parser* parser) {
+    return parse_binary(parser, 1);
+}
+
+// Free an AST.
+// Every node lives in the arena owned by the root NODE_PROGRAM, so freeing
+// the root releases the whole tree at once; other nodes go with it.
+void free_ast(ASTNode* node) {
+    if (!node || node->type != NODE_PROGRAM) return;
+    free_arena(node->data.program.arena);
 }
 
 // Print AST for debugging
@@ -406,11 +907,20 @@ void print_ast(ASTNode* node, int depth) {
             }
             break;
         case NODE_FUNCTION_DEFINITION:
+            if (!node->data.function_definition.body && node->data.function_definition.lazy) {
+                printf("Function: %s (not parsed yet)\n", node->data.function_definition.name);
+                break;
+            }
             printf("Function: %s\n", node->data.function_definition.name);
             print_ast(node->data.function_definition.body, depth + 1);
             break;
         case NODE_TEXT:
-            printf("Text: %s\n", node->data.text.content);
+            if (node->data.text.content) {
+                printf("Text: %s\n", node->data.text.content);
+            } else {
+                printf("Text:\n");
+                print_ast(node->data.text.expr, depth + 1);
+            }
             break;
         case NODE_STRING_LITERAL:
             printf("String: %s\n", node->data.string_literal.value);
@@ -432,6 +942,18 @@ void print_ast(ASTNode* node, int depth) {
             printf("Game engine:\n");
             print_ast(node->data.game_engine.expr, depth + 1);
             break;
+        case NODE_BOOLEAN:
+            printf("Boolean: %s\n", node->data.boolean.value ? "true" : "false");
+            break;
+        case NODE_UNARY:
+            printf("Unary: %s\n", operator_name(node->data.unary.op));
+            print_ast(node->data.unary.operand, depth + 1);
+            break;
+        case NODE_BINARY:
+            printf("Binary: %s\n", operator_name(node->data.binary.op));
+            print_ast(node->data.binary.left, depth + 1);
+            print_ast(node->data.binary.right, depth + 1);
+            break;
         default:
             printf("Unknown node type\n");
             break;
@@ -0,0 +1,170 @@
+#include "register_chunk.h"
+#include "object.h"
+#include <stdlib.h>
+
+void init_register_chunk(RegisterChunk* chunk) {
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->code = NULL;
+    chunk->lines = NULL;
+    init_value_array(&chunk->constants);
+    chunk->register_count = 0;
+}
+
+void free_register_chunk(RegisterChunk* chunk) {
+    free(chunk->code);
+    free(chunk->lines);
+    free_value_array(&chunk->constants);
+    init_register_chunk(chunk);
+}
+
+void register_chunk_write(RegisterChunk* chunk, uint32_t word, int line) {
+    if (chunk->count >= chunk->capacity) {
+        chunk->capacity = chunk->capacity < 32 ? 32 : chunk->capacity * 2;
+        chunk->code = (uint32_t*)realloc(chunk->code, chunk->capacity * sizeof(uint32_t));
+        chunk->lines = (int*)realloc(chunk->lines, chunk->capacity * sizeof(int));
+        if (!chunk->code || !chunk->lines) {
+            fprintf(stderr, "Failed to grow register chunk\n");
+            exit(1);
+        }
+    }
+    chunk->code[chunk->count] = word;
+    chunk->lines[chunk->count] = line;
+    chunk->count++;
+}
+
+int register_chunk_add_constant(RegisterChunk* chunk, Value value) {
+    write_value_array(&chunk->constants, value);
+    return chunk->constants.count - 1;
+}
+
+static const char* register_opcode_name(uint8_t op) {
+    switch (op) {
+        case ROP_LOAD_CONSTANT: return "LOAD_CONSTANT";
+        case ROP_GET_GLOBAL: return "GET_GLOBAL";
+        case ROP_DEFINE_GLOBAL: return "DEFINE_GLOBAL";
+        case ROP_EQUAL: return "EQUAL";
+        case ROP_NOT_EQUAL: return "NOT_EQUAL";
+        case ROP_GREATER: return "GREATER";
+        case ROP_LESS: return "LESS";
+        case ROP_GREATER_EQUAL: return "GREATER_EQUAL";
+        case ROP_LESS_EQUAL: return "LESS_EQUAL";
+        case ROP_ADD: return "ADD";
+        case ROP_SUBTRACT: return "SUBTRACT";
+        case ROP_MULTIPLY: return "MULTIPLY";
+        case ROP_DIVIDE: return "DIVIDE";
+        case ROP_NOT: return "NOT";
+        case ROP_NEGATE: return "NEGATE";
+        case ROP_TO_NUMBER: return "TO_NUMBER";
+        case ROP_INPUT: return "INPUT";
+        case ROP_PRINT: return "PRINT";
+        case ROP_GAME_ENGINE: return "GAME_ENGINE";
+        case ROP_ANIMATE: return "ANIMATE";
+        case ROP_CALL_GLOBAL: return "CALL_GLOBAL";
+        case ROP_TAIL_CALL_GLOBAL: return "TAIL_CALL_GLOBAL";
+        case ROP_RETURN: return "RETURN";
+        default: return NULL;
+    }
+}
+
+static void print_constant(Value value) {
+    switch (value_type(value)) {
+        case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
+        case VAL_STRING: printf("\"%s\"", AS_STRING(value)); break;
+        case VAL_BOOLEAN: printf("%s", AS_BOOL(value) ? "true" : "false"); break;
+        case VAL_FUNCTION: printf("<function %s>", AS_FUNCTION(value)->name); break;
+        case VAL_ANIMATION: printf("<animation %s %s>", AS_ANIMATION(value)->emoji, AS_ANIMATION(value)->action); break;
+        default: printf("null"); break;
+    }
+}
+
+static void print_rk(const RegisterChunk* chunk, int rk) {
+    if (rk < RK_CONSTANT) {
+        printf(" r%d", rk);
+    } else {
+        printf(" k%d(", rk - RK_CONSTANT);
+        print_constant(chunk->constants.values[rk - RK_CONSTANT]);
+        printf(")");
+    }
+}
+
+static void print_slot(int slot, const char** globals) {
+    printf(" g%d", slot);
+    if (globals) printf("('%s')", globals[slot]);
+}
+
+// Print the instruction at offset and return the offset of the next one
+static int disassemble_register_instruction(const RegisterChunk* chunk, int offset,
+                                            const char** globals) {
+    printf("%04d ", offset);
+    if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
+        printf("   | ");
+    } else {
+        printf("%4d ", chunk->lines[offset]);
+    }
+
+    uint32_t word = chunk->code[offset];
+    uint8_t op = DECODE_OP(word);
+    const char* name = register_opcode_name(op);
+    if (!name) {
+        printf("Unknown opcode %d\n", op);
+        return offset + 1;
+    }
+
+    printf("%-16s", name);
+    switch (op) {
+        case ROP_LOAD_CONSTANT:
+        case ROP_INPUT:
+            printf(" r%d", DECODE_A(word));
+            print_rk(chunk, RK_CONSTANT + DECODE_BX(word));
+            break;
+        case ROP_GET_GLOBAL:
+            printf(" r%d", DECODE_A(word));
+            print_slot((int)chunk->code[offset + 1], globals);
+            printf("\n");
+            return offset + 2;
+        case ROP_DEFINE_GLOBAL:
+            print_slot((int)chunk->code[offset + 1], globals);
+            print_rk(chunk, DECODE_B(word));
+            printf("\n");
+            return offset + 2;
+        case ROP_NOT:
+        case ROP_NEGATE:
+        case ROP_TO_NUMBER:
+            printf(" r%d", DECODE_A(word));
+            break;
+        case ROP_PRINT:
+        case ROP_ANIMATE:
+            print_rk(chunk, DECODE_B(word));
+            break;
+        case ROP_CALL_GLOBAL:
+        case ROP_TAIL_CALL_GLOBAL:
+            print_slot((int)DECODE_SX(word), globals);
+            break;
+        case ROP_GAME_ENGINE:
+        case ROP_RETURN:
+            break;
+        default:
+            printf(" r%d", DECODE_A(word));
+            print_rk(chunk, DECODE_C(word));
+            break;
+    }
+    printf("\n");
+    return offset + 1;
+}
+
+void disassemble_register_chunk(const RegisterChunk* chunk, const char* name, const char** globals) {
+    printf("== %s (%d registers) ==\n", name, chunk->register_count);
+    for (int offset = 0; offset < chunk->count;) {
+        offset = disassemble_register_instruction(chunk, offset, globals);
+    }
+
+    for (int i = 0; i < chunk->constants.count; i++) {
+        Value value = chunk->constants.values[i];
+        if (!IS_FUNCTION(value)) continue;
+        const ObjFunction* function = AS_FUNCTION(value);
+        if (function->registers) {
+            disassemble_register_chunk(function->registers, function->name, globals);
+        }
+    }
+}
@@ -0,0 +1,279 @@
+#include "register_compiler.h"
+#include "resolver.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_CONSTANTS (UINT16_MAX + 1)
+#define MAX_GLOBALS (1 << 24)
+
+static void compile_into(RegisterCompiler* compiler, ASTNode* node, int target);
+
+void init_register_compiler(RegisterCompiler* compiler, VM* vm, RegisterChunk* chunk, bool lazy) {
+    compiler->vm = vm;
+    compiler->chunk = chunk;
+    compiler->lazy = lazy;
+    compiler->had_error = false;
+    compiler->next_register = 0;
+    compiler->last_call = -1;
+}
+
+static void error(RegisterCompiler* compiler, const char* message, int line) {
+    if (!compiler->had_error) fprintf(stderr, "%s at line %d\n", message, line);
+    compiler->had_error = true;
+}
+
+static void emit(RegisterCompiler* compiler, uint32_t word, int line) {
+    register_chunk_write(compiler->chunk, word, line);
+}
+
+static int check_slot(RegisterCompiler* compiler, int slot, int line) {
+    if (slot >= MAX_GLOBALS) {
+        error(compiler, "Too many global names", line);
+        return 0;
+    }
+    return slot;
+}
+
+static int allocate_register(RegisterCompiler* compiler, int line) {
+    if (compiler->next_register >= MAX_REGISTERS) {
+        error(compiler, "Expression needs too many registers", line);
+        return 0;
+    }
+    int reg = compiler->next_register++;
+    if (compiler->next_register > compiler->chunk->register_count) {
+        compiler->chunk->register_count = compiler->next_register;
+    }
+    return reg;
+}
+
+// Constant index for value. Equal numbers and interned strings share a
+// slot if it can be an RK operand.
+static int make_constant(RegisterCompiler* compiler, Value value, int line) {
+    ValueArray* constants = &compiler->chunk->constants;
+    for (int i = 0; i < constants->count && i < RK_CONSTANT; i++) {
+        if (constants->values[i] == value) return i;
+    }
+    if (constants->count >= MAX_CONSTANTS) {
+        error(compiler, "Too many constants in one chunk", line);
+        return 0;
+    }
+    return register_chunk_add_constant(compiler->chunk, value);
+}
+
+// Value of a node that needs no code, number conversions of literals
+// included
+static bool constant_value(RegisterCompiler* compiler, ASTNode* node, Value* value) {
+    if (!node) {
+        *value = NULL_VAL;
+        return true;
+    }
+    switch (node->type) {
+        case NODE_NUMBER: *value = NUMBER_VAL(node->data.number.value); return true;
+        case NODE_STRING_LITERAL: *value = STRING_VAL(node->data.string_literal.value); return true;
+        case NODE_TEXT: *value = STRING_VAL(node->data.text.content); return true;
+        case NODE_BOOLEAN: *value = BOOL_VAL(node->data.boolean.value); return true;
+        case NODE_NUMBER_CONVERSION: {
+            Value operand;
+            if (!constant_value(compiler, node->data.number_conversion.expr, &operand)) return false;
+            *value = convert_to_number(operand);
+            return true;
+        }
+        case NODE_UNARY: {
+            // Negating anything but a number is a runtime error, left to run
+            Value operand;
+            if (!constant_value(compiler, node->data.unary.operand, &operand)) return false;
+            if (node->data.unary.op != TOKEN_BANG && !IS_NUMBER(operand)) return false;
+            *value = apply_unary(compiler->vm, node->data.unary.op, operand);
+            return true;
+        }
+        case NODE_ANIMATION: {
+            // Animations are immutable, so the whole record is one constant
+            ObjAnimation* animation = new_animation(compiler->vm, node->data.animation.emoji,
+                                                    node->data.animation.action,
+                                                    node->data.animation.distance,
+                                                    node->data.animation.repeat,
+                                                    node->data.animation.speed);
+            *value = OBJ_VAL(animation);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// RK operand for a constant value, loading it into a new register if its
+// index is too large
+static int constant_operand(RegisterCompiler* compiler, Value value, int line) {
+    int index = make_constant(compiler, value, line);
+    if (index < RK_CONSTANT) return RK_CONSTANT + index;
+    int reg = allocate_register(compiler, line);
+    emit(compiler, ENCODE_ABX(ROP_LOAD_CONSTANT, reg, index), line);
+    return reg;
+}
+
+// RK operand holding node's value. Anything but a constant is compiled
+// into target, or into a new register if target is -1.
+static int operand(RegisterCompiler* compiler, ASTNode* node, int target) {
+    int line = node ? node->line : 0;
+    Value value;
+    if (constant_value(compiler, node, &value)) return constant_operand(compiler, value, line);
+    if (target < 0) target = allocate_register(compiler, line);
+    compile_into(compiler, node, target);
+    return target;
+}
+
+static uint8_t binary_opcode(RegisterCompiler* compiler, ASTNode* node) {
+    switch (node->data.binary.op) {
+        case TOKEN_PLUS: return ROP_ADD;
+        case TOKEN_MINUS: return ROP_SUBTRACT;
+        case TOKEN_MULTIPLY: return ROP_MULTIPLY;
+        case TOKEN_DIVIDE: return ROP_DIVIDE;
+        case TOKEN_EQ: return ROP_EQUAL;
+        case TOKEN_NEQ: return ROP_NOT_EQUAL;
+        case TOKEN_LT: return ROP_LESS;
+        case TOKEN_GT: return ROP_GREATER;
+        case TOKEN_LTE: return ROP_LESS_EQUAL;
+        case TOKEN_GTE: return ROP_GREATER_EQUAL;
+        default:
+            error(compiler, "Unknown binary operator", node->line);
+            return ROP_ADD;
+    }
+}
+
+// Compile node so that its value ends up in register target. The left or
+// only operand of an operator is computed in target itself, constant or
+// not, and the operator works on it in place; registers allocated for the
+// rest are free again afterwards.
+static void compile_into(RegisterCompiler* compiler, ASTNode* node, int target) {
+    int line = node ? node->line : 0;
+    Value value;
+    if (constant_value(compiler, node, &value)) {
+        emit(compiler, ENCODE_ABX(ROP_LOAD_CONSTANT, target, make_constant(compiler, value, line)), line);
+        return;
+    }
+
+    int saved = compiler->next_register;
+    switch (node->type) {
+        case NODE_IDENTIFIER:
+            emit(compiler, ENCODE_ABC(ROP_GET_GLOBAL, target, 0, 0), line);
+            emit(compiler, (uint32_t)check_slot(compiler, node_slot(compiler->vm, node), line), line);
+            break;
+        case NODE_INPUT:
+            emit(compiler, ENCODE_ABX(ROP_INPUT, target,
+                                      make_constant(compiler, STRING_VAL(node->data.input.prompt), line)),
+                 line);
+            break;
+        case NODE_NUMBER_CONVERSION:
+            compile_into(compiler, node->data.number_conversion.expr, target);
+            emit(compiler, ENCODE_ABC(ROP_TO_NUMBER, target, 0, 0), line);
+            break;
+        case NODE_UNARY: {
+            compile_into(compiler, node->data.unary.operand, target);
+            uint8_t op = node->data.unary.op == TOKEN_BANG ? ROP_NOT : ROP_NEGATE;
+            emit(compiler, ENCODE_ABC(op, target, 0, 0), line);
+            break;
+        }
+        case NODE_BINARY: {
+            uint8_t op = binary_opcode(compiler, node);
+            compile_into(compiler, node->data.binary.left, target);
+            int c = operand(compiler, node->data.binary.right, -1);
+            emit(compiler, ENCODE_ABC(op, target, 0, c), line);
+            break;
+        }
+        default:
+            fprintf(stderr, "Cannot compile expression of type %d at line %d\n", node->type, line);
+            compiler->had_error = true;
+            break;
+    }
+    compiler->next_register = saved;
+}
+
+static void compile_function_definition(RegisterCompiler* compiler, ASTNode* node) {
+    ObjFunction* function = new_function(compiler->vm, node->data.function_definition.name, node);
+    if (!compiler->lazy && !compile_register_function(compiler->vm, function, false)) {
+        compiler->had_error = true;
+    }
+
+    int b = constant_operand(compiler, OBJ_VAL(function), node->line);
+    emit(compiler, ENCODE_ABC(ROP_DEFINE_GLOBAL, 0, b, 0), node->line);
+    emit(compiler, (uint32_t)check_slot(compiler, node_slot(compiler->vm, node), node->line), node->line);
+}
+
+void compile_register_statement(RegisterCompiler* compiler, ASTNode* node) {
+    if (!node) return;
+
+    int line = node->line;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                compile_register_statement(compiler, node->data.program.statements[i]);
+            }
+            break;
+        case NODE_FUNCTION_DEFINITION:
+            compile_function_definition(compiler, node);
+            break;
+        case NODE_TEXT: {
+            ASTNode* expr = node->data.text.expr ? node->data.text.expr : node;
+            emit(compiler, ENCODE_ABC(ROP_PRINT, 0, operand(compiler, expr, -1), 0), line);
+            break;
+        }
+        case NODE_IDENTIFIER:
+            // A bare name as a statement is a call
+            compiler->last_call = compiler->chunk->count;
+            emit(compiler, ENCODE_SX(ROP_CALL_GLOBAL,
+                                     check_slot(compiler, node_slot(compiler->vm, node), line)),
+                 line);
+            break;
+        case NODE_GAME_ENGINE:
+            emit(compiler, ENCODE_ABC(ROP_GAME_ENGINE, 0, 0, 0), line);
+            for (int i = 0; i < node->data.game_engine.animation_count; i++) {
+                int b = operand(compiler, node->data.game_engine.animations[i], -1);
+                emit(compiler, ENCODE_ABC(ROP_ANIMATE, 0, b, 0), line);
+            }
+            break;
+        default:
+            // Any other expression is evaluated for its effects
+            compile_into(compiler, node, allocate_register(compiler, line));
+            break;
+    }
+    compiler->next_register = 0;
+}
+
+void emit_register_return(RegisterCompiler* compiler, int line) {
+    RegisterChunk* chunk = compiler->chunk;
+    if (compiler->last_call >= 0 && compiler->last_call == chunk->count - 1) {
+        chunk->code[compiler->last_call] = ENCODE_SX(ROP_TAIL_CALL_GLOBAL,
+                                                     DECODE_SX(chunk->code[compiler->last_call]));
+    }
+    emit(compiler, ENCODE_ABC(ROP_RETURN, 0, 0, 0), line);
+}
+
+bool compile_register_program(RegisterCompiler* compiler, ASTNode* program) {
+    compile_register_statement(compiler, program);
+    emit_register_return(compiler, 0);
+    return !compiler->had_error;
+}
+
+bool compile_register_function(VM* vm, ObjFunction* function, bool lazy) {
+    ASTNode* body = parse_function_body(function->definition);
+    if (!body) return false;
+    resolve_ast(vm, body);
+
+    RegisterChunk* chunk = (RegisterChunk*)malloc(sizeof(RegisterChunk));
+    if (!chunk) {
+        fprintf(stderr, "Failed to allocate memory for function registers\n");
+        exit(1);
+    }
+    init_register_chunk(chunk);
+
+    RegisterCompiler compiler;
+    init_register_compiler(&compiler, vm, chunk, lazy);
+    if (!compile_register_program(&compiler, body)) {
+        free_register_chunk(chunk);
+        free(chunk);
+        return false;
+    }
+
+    function->registers = chunk;
+    return true;
+}
@@ -0,0 +1,74 @@
+#include "resolver.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int resolve_global(VM* vm, const char* name) {
+    Value slot;
+    if (tableGet(&vm->symbols.slots, name, &slot)) {
+        return (int)AS_NUMBER(slot);
+    }
+
+    if (vm->symbols.count >= vm->symbols.capacity) {
+        vm->symbols.capacity *= 2;
+        vm->symbols.names = (const char**)realloc(vm->symbols.names, vm->symbols.capacity * sizeof(const char*));
+        vm->symbols.values = (Value*)realloc(vm->symbols.values, vm->symbols.capacity * sizeof(Value));
+        if (!vm->symbols.names || !vm->symbols.values) {
+            fprintf(stderr, "Failed to grow symbol table\n");
+            exit(1);
+        }
+    }
+
+    // New slots read as null until something is defined in them
+    int index = vm->symbols.count++;
+    vm->symbols.names[index] = name;
+    vm->symbols.values[index] = NULL_VAL;
+    tableSet(&vm->symbols.slots, name, NUMBER_VAL(index));
+    return index;
+}
+
+int node_slot(VM* vm, ASTNode* node) {
+    if (node->type == NODE_FUNCTION_DEFINITION) {
+        if (node->data.function_definition.slot == UNRESOLVED_SLOT) {
+            node->data.function_definition.slot = resolve_global(vm, node->data.function_definition.name);
+        }
+        return node->data.function_definition.slot;
+    }
+    if (node->data.identifier.slot == UNRESOLVED_SLOT) {
+        node->data.identifier.slot = resolve_global(vm, node->data.identifier.name);
+    }
+    return node->data.identifier.slot;
+}
+
+void resolve_ast(VM* vm, ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                resolve_ast(vm, node->data.program.statements[i]);
+            }
+            break;
+        case NODE_FUNCTION_DEFINITION:
+            node_slot(vm, node);
+            resolve_ast(vm, node->data.function_definition.body);
+            break;
+        case NODE_IDENTIFIER:
+            node_slot(vm, node);
+            break;
+        case NODE_TEXT:
+            resolve_ast(vm, node->data.text.expr);
+            break;
+        case NODE_NUMBER_CONVERSION:
+            resolve_ast(vm, node->data.number_conversion.expr);
+            break;
+        case NODE_UNARY:
+            resolve_ast(vm, node->data.unary.operand);
+            break;
+        case NODE_BINARY:
+            resolve_ast(vm, node->data.binary.left);
+            resolve_ast(vm, node->data.binary.right);
+            break;
+        default:
+            break;
+    }
+}
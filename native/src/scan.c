@@ -0,0 +1,261 @@
+#include "scan.h"
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+// Kernel table, chosen on first use
+typedef struct {
+    const char* name;
+    size_t (*whitespace)(const char* src, size_t pos, size_t end);
+    size_t (*identifier)(const char* src, size_t pos, size_t end);
+    size_t (*string_body)(const char* src, size_t pos, size_t end);
+    int (*count_newlines)(const char* src, size_t pos, size_t end, size_t* last_newline);
+} ScanKernel;
+
+// Scalar character classes (ASCII only, matching the C locale)
+static inline int is_space_byte(unsigned char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static inline int is_identifier_byte(unsigned char c) {
+    return (unsigned char)((c | 0x20) - 'a') <= 'z' - 'a' ||
+           (unsigned char)(c - '0') <= 9 || c == '_';
+}
+
+// Scalar kernels, also used for the tails of the SIMD kernels
+static size_t scalar_whitespace(const char* src, size_t pos, size_t end) {
+    while (pos < end && is_space_byte((unsigned char)src[pos])) pos++;
+    return pos;
+}
+
+static size_t scalar_identifier(const char* src, size_t pos, size_t end) {
+    while (pos < end && is_identifier_byte((unsigned char)src[pos])) pos++;
+    return pos;
+}
+
+static size_t scalar_string_body(const char* src, size_t pos, size_t end) {
+    while (pos < end && src[pos] != '"' && src[pos] != '\0') pos++;
+    return pos;
+}
+
+static int scalar_count_newlines(const char* src, size_t pos, size_t end, size_t* last_newline) {
+    int count = 0;
+    for (; pos < end; pos++) {
+        if (src[pos] == '\n') {
+            count++;
+            *last_newline = pos;
+        }
+    }
+    return count;
+}
+
+static const ScanKernel scalar_kernel = {
+    "scalar",
+    scalar_whitespace,
+    scalar_identifier,
+    scalar_string_body,
+    scalar_count_newlines
+};
+
+#ifdef SCAN_X86
+
+// SSE2 kernels: 16 bytes per step
+// Each *_mask helper returns a bitmask with one bit set per byte in the class.
+
+__attribute__((target("sse2")))
+static inline unsigned sse2_space_mask(__m128i v) {
+    __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    __m128i ctl = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    ctl = _mm_cmpeq_epi8(_mm_min_epu8(ctl, _mm_set1_epi8('\r' - '\t')), ctl);
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(space, ctl));
+}
+
+__attribute__((target("sse2")))
+static inline unsigned sse2_identifier_mask(__m128i v) {
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8('z' - 'a')), alpha);
+    __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+
+__attribute__((target("sse2")))
+static inline unsigned sse2_string_stop_mask(__m128i v) {
+    __m128i quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+    __m128i nul = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(quote, nul));
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_whitespace(const char* src, size_t pos, size_t end) {
+    for (; pos + 16 <= end; pos += 16) {
+        unsigned stop = ~sse2_space_mask(_mm_loadu_si128((const __m128i*)(src + pos))) & 0xFFFF;
+        if (stop) return pos + __builtin_ctz(stop);
+    }
+    return scalar_whitespace(src, pos, end);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_identifier(const char* src, size_t pos, size_t end) {
+    for (; pos + 16 <= end; pos += 16) {
+        unsigned stop = ~sse2_identifier_mask(_mm_loadu_si128((const __m128i*)(src + pos))) & 0xFFFF;
+        if (stop) return pos + __builtin_ctz(stop);
+    }
+    return scalar_identifier(src, pos, end);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_string_body(const char* src, size_t pos, size_t end) {
+    for (; pos + 16 <= end; pos += 16) {
+        unsigned stop = sse2_string_stop_mask(_mm_loadu_si128((const __m128i*)(src + pos)));
+        if (stop) return pos + __builtin_ctz(stop);
+    }
+    return scalar_string_body(src, pos, end);
+}
+
+__attribute__((target("sse2")))
+static int sse2_count_newlines(const char* src, size_t pos, size_t end, size_t* last_newline) {
+    int count = 0;
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        if (mask) {
+            count += __builtin_popcount(mask);
+            *last_newline = pos + 31 - __builtin_clz(mask);
+        }
+    }
+    return count + scalar_count_newlines(src, pos, end, last_newline);
+}
+
+static const ScanKernel sse2_kernel = {
+    "sse2",
+    sse2_whitespace,
+    sse2_identifier,
+    sse2_string_body,
+    sse2_count_newlines
+};
+
+// AVX2 kernels: 32 bytes per step
+
+__attribute__((target("avx2")))
+static inline uint32_t avx2_space_mask(__m256i v) {
+    __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    __m256i ctl = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, _mm256_set1_epi8('\r' - '\t')), ctl);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(space, ctl));
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t avx2_identifier_mask(__m256i v) {
+    __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8('z' - 'a')), alpha);
+    __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t avx2_string_stop_mask(__m256i v) {
+    __m256i quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+    __m256i nul = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(quote, nul));
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_whitespace(const char* src, size_t pos, size_t end) {
+    for (; pos + 32 <= end; pos += 32) {
+        uint32_t stop = ~avx2_space_mask(_mm256_loadu_si256((const __m256i*)(src + pos)));
+        if (stop) return pos + __builtin_ctz(stop);
+    }
+    return sse2_whitespace(src, pos, end);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_identifier(const char* src, size_t pos, size_t end) {
+    for (; pos + 32 <= end; pos += 32) {
+        uint32_t stop = ~avx2_identifier_mask(_mm256_loadu_si256((const __m256i*)(src + pos)));
+        if (stop) return pos + __builtin_ctz(stop);
+    }
+    return sse2_identifier(src, pos, end);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_string_body(const char* src, size_t pos, size_t end) {
+    for (; pos + 32 <= end; pos += 32) {
+        uint32_t stop = avx2_string_stop_mask(_mm256_loadu_si256((const __m256i*)(src + pos)));
+        if (stop) return pos + __builtin_ctz(stop);
+    }
+    return sse2_string_body(src, pos, end);
+}
+
+__attribute__((target("avx2")))
+static int avx2_count_newlines(const char* src, size_t pos, size_t end, size_t* last_newline) {
+    int count = 0;
+    for (; pos + 32 <= end; pos += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + pos));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        if (mask) {
+            count += __builtin_popcount(mask);
+            *last_newline = pos + 31 - __builtin_clz(mask);
+        }
+    }
+    return count + sse2_count_newlines(src, pos, end, last_newline);
+}
+
+static const ScanKernel avx2_kernel = {
+    "avx2",
+    avx2_whitespace,
+    avx2_identifier,
+    avx2_string_body,
+    avx2_count_newlines
+};
+
+#endif // SCAN_X86
+
+// Pick the widest kernel the CPU supports
+static const ScanKernel* select_kernel(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &avx2_kernel;
+    if (__builtin_cpu_supports("sse2")) return &sse2_kernel;
+#endif
+    return &scalar_kernel;
+}
+
+// Every thread that races here stores the same pointer, so a relaxed
+// atomic is enough to make the lazy selection safe.
+static const ScanKernel* active_kernel = NULL;
+
+static inline const ScanKernel* kernel(void) {
+    const ScanKernel* k = __atomic_load_n(&active_kernel, __ATOMIC_RELAXED);
+    if (!k) {
+        k = select_kernel();
+        __atomic_store_n(&active_kernel, k, __ATOMIC_RELAXED);
+    }
+    return k;
+}
+
+size_t scan_whitespace(const char* src, size_t pos, size_t end) {
+    return kernel()->whitespace(src, pos, end);
+}
+
+size_t scan_identifier(const char* src, size_t pos, size_t end) {
+    return kernel()->identifier(src, pos, end);
+}
+
+size_t scan_string_body(const char* src, size_t pos, size_t end) {
+    return kernel()->string_body(src, pos, end);
+}
+
+int scan_count_newlines(const char* src, size_t pos, size_t end, size_t* last_newline) {
+    return kernel()->count_newlines(src, pos, end, last_newline);
+}
+
+const char* scan_backend(void) {
+    return kernel()->name;
+}
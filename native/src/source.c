@@ -0,0 +1,201 @@
+#include "source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define READ_CHUNK_SIZE (64 * 1024)
+
+static size_t page_size(void) {
+    return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Read a source that can't be mapped (pipe, device, empty file) into the heap
+static bool read_source(int fd, const char* filename, Source* source) {
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t length = 0;
+    char* buffer = (char*)malloc(capacity + 1);
+    if (!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+
+    for (;;) {
+        if (length == capacity) {
+            capacity *= 2;
+            char* grown = (char*)realloc(buffer, capacity + 1);
+            if (!grown) {
+                free(buffer);
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                return false;
+            }
+            buffer = grown;
+        }
+        ssize_t n = read(fd, buffer + length, capacity - length);
+        if (n < 0) {
+            free(buffer);
+            fprintf(stderr, "Error: Could not read file '%s'\n", filename);
+            return false;
+        }
+        if (n == 0) break;
+        length += (size_t)n;
+    }
+
+    buffer[length] = '\0';
+    source->data = buffer;
+    source->length = length;
+    source->mapping_size = 0;
+    return true;
+}
+
+// Load a whole source file.
+// Regular files are mapped read-only with MADV_SEQUENTIAL instead of being
+// copied into the heap. The mapping is reserved one byte longer than the
+// file (rounded to a page) so the byte after the last one is always a zero.
+bool load_source(const char* filename, Source* source) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open file '%s'\n", filename);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        bool ok = read_source(fd, filename, source);
+        close(fd);
+        return ok;
+    }
+
+    size_t length = (size_t)st.st_size;
+    size_t page = page_size();
+    size_t mapping_size = (length + 1 + page - 1) & ~(page - 1);
+
+    // Reserve zeroed address space, then map the file over the front of it
+    char* base = (char*)mmap(NULL, mapping_size, PROT_READ,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED ||
+        mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        if (base != MAP_FAILED) munmap(base, mapping_size);
+        bool ok = read_source(fd, filename, source);
+        close(fd);
+        return ok;
+    }
+    madvise(base, length, MADV_SEQUENTIAL);
+    close(fd);
+
+    source->data = base;
+    source->length = length;
+    source->mapping_size = mapping_size;
+    return true;
+}
+
+void release_source(Source* source) {
+    if (!source->data) return;
+    if (source->mapping_size) {
+        munmap((void*)source->data, source->mapping_size);
+    } else {
+        free((void*)source->data);
+    }
+    source->data = NULL;
+    source->length = 0;
+    source->mapping_size = 0;
+}
+
+// Map at least min_length bytes of the file starting at the page-aligned
+// offset, replacing the current window, and point the lexer at it
+static bool map_window(SourceStream* stream, size_t offset, size_t min_length) {
+    size_t length = min_length > stream->window_size ? min_length : stream->window_size;
+    if (length > stream->file_size - offset) length = stream->file_size - offset;
+
+    if (stream->window) {
+        munmap(stream->window, stream->window_length);
+        stream->window = NULL;
+    }
+
+    char* window = (char*)mmap(NULL, length, PROT_READ, MAP_PRIVATE, stream->fd, (off_t)offset);
+    if (window == MAP_FAILED) return false;
+    madvise(window, length, MADV_SEQUENTIAL);
+
+    stream->window = window;
+    stream->window_offset = offset;
+    stream->window_length = length;
+    stream->lexer.source = window;
+    stream->lexer.length = length;
+    stream->lexer.base = offset;
+    return true;
+}
+
+bool open_source_stream(const char* filename, size_t window_size, SourceStream* stream) {
+    stream->fd = open(filename, O_RDONLY);
+    if (stream->fd < 0) {
+        fprintf(stderr, "Error: Could not open file '%s'\n", filename);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(stream->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Error: '%s' is not a regular file\n", filename);
+        close(stream->fd);
+        return false;
+    }
+
+    size_t page = page_size();
+    stream->file_size = (size_t)st.st_size;
+    stream->window_size = (window_size + page - 1) & ~(page - 1);
+    if (stream->window_size == 0) stream->window_size = page;
+    stream->window_offset = 0;
+    stream->window_length = 0;
+    stream->window = NULL;
+    init_lexer(&stream->lexer, "", 0);
+
+    if (stream->file_size > 0 && !map_window(stream, 0, stream->window_size)) {
+        fprintf(stderr, "Error: Could not map file '%s'\n", filename);
+        close(stream->fd);
+        return false;
+    }
+    return true;
+}
+
+// Lex the next token, sliding the window whenever a token runs into its end.
+// A token that touches the end of a window that isn't the end of the file
+// might continue past it, so the window is moved to start at that token
+// (growing it if the token alone is bigger than a window) and it is lexed
+// again from the saved lexer state.
+Token source_stream_next(SourceStream* stream) {
+    for (;;) {
+        Lexer saved = stream->lexer;
+        Token token = get_next_token(&stream->lexer);
+
+        bool window_at_eof = stream->window_offset + stream->window_length >= stream->file_size;
+        if (window_at_eof || stream->lexer.position < stream->lexer.length) {
+            return token;
+        }
+
+        size_t start = saved.base + saved.position;
+        size_t offset = start & ~(page_size() - 1);
+        size_t needed = stream->window_offset + stream->window_length - offset;
+        if (!map_window(stream, offset, needed * 2)) {
+            stream->lexer.error = "Could not map source window";
+            token.type = TOKEN_ERROR;
+            return token;
+        }
+        stream->lexer.position = start - offset;
+        stream->lexer.line = saved.line;
+        stream->lexer.column = saved.column;
+        stream->lexer.error = NULL;
+    }
+}
+
+void close_source_stream(SourceStream* stream) {
+    if (stream->window) {
+        munmap(stream->window, stream->window_length);
+        stream->window = NULL;
+    }
+    if (stream->fd >= 0) {
+        close(stream->fd);
+        stream->fd = -1;
+    }
+}
@@ -0,0 +1,203 @@
+#include "table.h"
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TABLE_SSE2 1
+#endif
+
+// Control bytes: full slots hold a 7-bit tag, so the high bit marks free ones
+#define CONTROL_EMPTY 0x80
+#define CONTROL_DELETED 0xFE
+
+// Entries plus tombstones may fill at most 7/8 of the slots, which leaves
+// an empty slot for every probe to stop at
+#define MAX_LOAD_NUMERATOR 7
+#define MAX_LOAD_DENOMINATOR 8
+
+// Bit i is set for slot i of a group
+typedef uint32_t GroupMask;
+
+static inline GroupMask match_byte(const uint8_t* group, uint8_t byte) {
+#ifdef TABLE_SSE2
+    __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+    GroupMask mask = 0;
+    for (int i = 0; i < TABLE_GROUP_SIZE; i++) {
+        if (group[i] == byte) mask |= (GroupMask)1 << i;
+    }
+    return mask;
+#endif
+}
+
+// Empty or deleted slots
+static inline GroupMask match_free(const uint8_t* group) {
+#ifdef TABLE_SSE2
+    return (GroupMask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    GroupMask mask = 0;
+    for (int i = 0; i < TABLE_GROUP_SIZE; i++) {
+        if (group[i] & 0x80) mask |= (GroupMask)1 << i;
+    }
+    return mask;
+#endif
+}
+
+// Interned hashes are FNV-1a, whose low bits are weak; mix them before
+// splitting into a group index and a tag
+static inline uint32_t mix_hash(const char* key) {
+    uint32_t hash = interned_hash(key);
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static inline uint8_t hash_tag(uint32_t hash) {
+    return (uint8_t)(hash >> 25);
+}
+
+static inline uint32_t first_group(const Table* table, uint32_t hash) {
+    return hash & (table->capacity / TABLE_GROUP_SIZE - 1);
+}
+
+// Groups are probed with triangular steps (1, 2, 3, ...), which visit every
+// group of a power-of-two table once
+static inline uint32_t next_group(const Table* table, uint32_t group, uint32_t step) {
+    return (group + step) & (table->capacity / TABLE_GROUP_SIZE - 1);
+}
+
+void initTable(Table* table) {
+    table->count = 0;
+    table->tombstones = 0;
+    table->capacity = 0;
+    table->control = NULL;
+    table->entries = NULL;
+}
+
+void freeTable(Table* table) {
+    free(table->control);
+    free(table->entries);
+    initTable(table);
+}
+
+// Slot holding key, or -1
+static int find_key(const Table* table, const char* key, uint32_t hash) {
+    uint8_t tag = hash_tag(hash);
+    uint32_t group = first_group(table, hash);
+    for (uint32_t step = 1;; step++) {
+        const uint8_t* control = &table->control[group * TABLE_GROUP_SIZE];
+        for (GroupMask match = match_byte(control, tag); match; match &= match - 1) {
+            int index = (int)(group * TABLE_GROUP_SIZE) + __builtin_ctz(match);
+            if (table->entries[index].key == key) return index;
+        }
+        // A probe for a key never continues past a group with an empty slot
+        if (match_byte(control, CONTROL_EMPTY)) return -1;
+        group = next_group(table, group, step);
+    }
+}
+
+// First empty or deleted slot on the probe sequence for hash
+static int find_free(const Table* table, uint32_t hash) {
+    uint32_t group = first_group(table, hash);
+    for (uint32_t step = 1;; step++) {
+        GroupMask free_slots = match_free(&table->control[group * TABLE_GROUP_SIZE]);
+        if (free_slots) return (int)(group * TABLE_GROUP_SIZE) + __builtin_ctz(free_slots);
+        group = next_group(table, group, step);
+    }
+}
+
+static void place(Table* table, int index, const char* key, uint32_t hash, Value value) {
+    table->control[index] = hash_tag(hash);
+    table->entries[index].key = key;
+    table->entries[index].value = value;
+}
+
+// Rehash into a table with room for one more entry. Tombstones are dropped,
+// so a table full of them is swept at the same size rather than doubled.
+static void resize(Table* table) {
+    int capacity = table->capacity < TABLE_GROUP_SIZE ? TABLE_GROUP_SIZE : table->capacity;
+    if ((table->count + 1) * 2 * MAX_LOAD_DENOMINATOR > capacity * MAX_LOAD_NUMERATOR) {
+        capacity *= 2;
+    }
+
+    Table grown;
+    grown.count = table->count;
+    grown.tombstones = 0;
+    grown.capacity = capacity;
+    grown.control = (uint8_t*)malloc(capacity);
+    grown.entries = (Entry*)malloc(capacity * sizeof(Entry));
+    if (!grown.control || !grown.entries) {
+        fprintf(stderr, "Failed to allocate memory for table\n");
+        exit(1);
+    }
+    memset(grown.control, CONTROL_EMPTY, capacity);
+
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->control[i] & 0x80) continue;
+        const Entry* entry = &table->entries[i];
+        uint32_t hash = mix_hash(entry->key);
+        place(&grown, find_free(&grown, hash), entry->key, hash, entry->value);
+    }
+
+    free(table->control);
+    free(table->entries);
+    *table = grown;
+}
+
+bool tableSet(Table* table, const char* key, Value value) {
+    uint32_t hash = mix_hash(key);
+    if (table->count > 0) {
+        int index = find_key(table, key, hash);
+        if (index >= 0) {
+            table->entries[index].value = value;
+            return false;
+        }
+    }
+
+    if ((table->count + table->tombstones + 1) * MAX_LOAD_DENOMINATOR >
+        table->capacity * MAX_LOAD_NUMERATOR) {
+        resize(table);
+    }
+
+    int index = find_free(table, hash);
+    if (table->control[index] == CONTROL_DELETED) table->tombstones--;
+    place(table, index, key, hash, value);
+    table->count++;
+    return true;
+}
+
+bool tableGet(const Table* table, const char* key, Value* value) {
+    if (table->count == 0) return false;
+
+    int index = find_key(table, key, mix_hash(key));
+    if (index < 0) return false;
+    *value = table->entries[index].value;
+    return true;
+}
+
+bool tableDelete(Table* table, const char* key) {
+    if (table->count == 0) return false;
+
+    int index = find_key(table, key, mix_hash(key));
+    if (index < 0) return false;
+
+    // Probes already stop at a group with an empty slot, so a slot there can
+    // be emptied outright; elsewhere it must become a tombstone
+    const uint8_t* group = &table->control[index & ~(TABLE_GROUP_SIZE - 1)];
+    if (match_byte(group, CONTROL_EMPTY)) {
+        table->control[index] = CONTROL_EMPTY;
+    } else {
+        table->control[index] = CONTROL_DELETED;
+        table->tombstones++;
+    }
+    table->entries[index].key = NULL;
+    table->count--;
+    return true;
+}
@@ -0,0 +1,149 @@
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+    ThreadTask task;
+    void* arg;
+} QueuedTask;
+
+struct ThreadPool {
+    pthread_t* threads;
+    int thread_count;
+
+    // Task queue (grows as needed, consumed from head)
+    QueuedTask* queue;
+    int head;
+    int tail;
+    int capacity;
+
+    int pending;             // Queued plus running tasks
+    bool shutting_down;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+};
+
+static void* worker_main(void* arg) {
+    ThreadPool* pool = (ThreadPool*)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->head == pool->tail && !pool->shutting_down) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->head == pool->tail && pool->shutting_down) break;
+
+        QueuedTask job = pool->queue[pool->head++];
+        pthread_mutex_unlock(&pool->lock);
+
+        job.task(job.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool* create_thread_pool(int thread_count) {
+    if (thread_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (int)cpus : 1;
+    }
+
+    ThreadPool* pool = (ThreadPool*)malloc(sizeof(ThreadPool));
+    if (!pool) {
+        fprintf(stderr, "Failed to allocate memory for thread pool\n");
+        return NULL;
+    }
+    pool->threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    pool->thread_count = 0;
+    pool->queue = NULL;
+    pool->head = 0;
+    pool->tail = 0;
+    pool->capacity = 0;
+    pool->pending = 0;
+    pool->shutting_down = false;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) break;
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        fprintf(stderr, "Failed to start thread pool workers\n");
+        free_thread_pool(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void free_thread_pool(ThreadPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->threads);
+    free(pool->queue);
+    free(pool);
+}
+
+int thread_pool_size(const ThreadPool* pool) {
+    return pool->thread_count;
+}
+
+void thread_pool_submit(ThreadPool* pool, ThreadTask task, void* arg) {
+    pthread_mutex_lock(&pool->lock);
+
+    // Reclaim consumed slots before growing
+    if (pool->tail >= pool->capacity && pool->head > 0) {
+        memmove(pool->queue, pool->queue + pool->head,
+                (pool->tail - pool->head) * sizeof(QueuedTask));
+        pool->tail -= pool->head;
+        pool->head = 0;
+    }
+    if (pool->tail >= pool->capacity) {
+        int new_capacity = pool->capacity < 16 ? 16 : pool->capacity * 2;
+        pool->queue = (QueuedTask*)realloc(pool->queue, new_capacity * sizeof(QueuedTask));
+        if (!pool->queue) {
+            fprintf(stderr, "Failed to grow thread pool queue\n");
+            exit(1);
+        }
+        pool->capacity = new_capacity;
+    }
+
+    pool->queue[pool->tail].task = task;
+    pool->queue[pool->tail].arg = arg;
+    pool->tail++;
+    pool->pending++;
+    pthread_cond_signal(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,59 @@
+#include "value.h"
+#include "intern.h"
+#include <stdio.h>
+
+void init_value_array(ValueArray* array) {
+    array->capacity = 0;
+    array->count = 0;
+    array->values = NULL;
+}
+
+void free_value_array(ValueArray* array) {
+    free(array->values);
+    init_value_array(array);
+}
+
+void write_value_array(ValueArray* array, Value value) {
+    if (array->count >= array->capacity) {
+        array->capacity = array->capacity < 8 ? 8 : array->capacity * 2;
+        array->values = (Value*)realloc(array->values, array->capacity * sizeof(Value));
+        if (!array->values) {
+            fprintf(stderr, "Failed to grow value array\n");
+            exit(1);
+        }
+    }
+    array->values[array->count++] = value;
+}
+
+// Shared string with room for length characters and one reference
+static SharedString* allocate_string(size_t length) {
+    SharedString* string = (SharedString*)malloc(sizeof(SharedString) + length + 1);
+    if (!string) {
+        fprintf(stderr, "Failed to allocate memory for string\n");
+        exit(1);
+    }
+    string->refs = 1;
+    string->length = (uint32_t)length;
+    string->chars[length] = '\0';
+    return string;
+}
+
+Value new_string(const char* chars, size_t length) {
+    SharedString* string = allocate_string(length);
+    memcpy(string->chars, chars, length);
+    return SHARED_STRING_VAL(string->chars);
+}
+
+size_t string_length(Value string) {
+    if (IS_SHARED_STRING(string)) return shared_string_header(string)->length;
+    return interned_length(AS_STRING(string));
+}
+
+Value concatenate_strings(Value a, Value b) {
+    size_t a_length = string_length(a);
+    size_t b_length = string_length(b);
+    SharedString* string = allocate_string(a_length + b_length);
+    memcpy(string->chars, AS_STRING(a), a_length);
+    memcpy(string->chars + a_length, AS_STRING(b), b_length);
+    return SHARED_STRING_VAL(string->chars);
+}
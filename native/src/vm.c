@@ -1,71 +1,204 @@
 #include "vm.h"
+#include "compiler.h"
+#include "register_compiler.h"
+#include "resolver.h"
+#include "number.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #define INITIAL_HEAP_SIZE 1024
-#define INITIAL_STACK_SIZE 256
 #define INITIAL_SYMBOL_TABLE_SIZE 64
 
+#ifdef VM_PROFILE_PAIRS
+uint64_t opcode_pair_counts[256][256];
+#endif
+
+#ifdef VM_COUNT_INSTRUCTIONS
+uint64_t executed_instructions;
+#define COUNT_INSTRUCTION() (executed_instructions++)
+#else
+#define COUNT_INSTRUCTION() ((void)0)
+#endif
+
+// Bytecode dispatch threads through a table of label addresses where the
+// compiler supports it; -DVM_SWITCH_DISPATCH selects the portable switch
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED_DISPATCH
+#endif
+
+// GCC's cross-jumping merges the handlers' indirect jumps back into one,
+// which undoes the threading
+#if defined(VM_THREADED_DISPATCH) && !defined(__clang__)
+#define DISPATCH_LOOP __attribute__((optimize("no-crossjumping")))
+#else
+#define DISPATCH_LOOP
+#endif
+
 VM* create_vm() {
     VM* vm = (VM*)malloc(sizeof(VM));
     if (!vm) return NULL;
-    
+    initVM(vm);
+    return vm;
+}
+
+void free_vm(VM* vm) {
+    if (!vm) return;
+    freeVM(vm);
+    free(vm);
+}
+
+void initVM(VM* vm) {
     // Initialize heap
     vm->heap = (void**)malloc(INITIAL_HEAP_SIZE * sizeof(void*));
     vm->heap_size = 0;
     vm->heap_capacity = INITIAL_HEAP_SIZE;
     
-    // Initialize stack
-    vm->stack = (void**)malloc(INITIAL_STACK_SIZE * sizeof(void*));
-    vm->stack_size = 0;
-    vm->stack_capacity = INITIAL_STACK_SIZE;
-    
-    // Initialize registers
-    vm->pc = NULL;
-    vm->sp = vm->stack;
-    vm->fp = vm->stack;
+    // Initialize string interner
+    init_interner(&vm->strings);
     
     // Initialize symbol table
-    vm->symbols.names = (char**)malloc(INITIAL_SYMBOL_TABLE_SIZE * sizeof(char*));
-    vm->symbols.values = (void**)malloc(INITIAL_SYMBOL_TABLE_SIZE * sizeof(void*));
+    vm->symbols.names = (const char**)malloc(INITIAL_SYMBOL_TABLE_SIZE * sizeof(const char*));
+    vm->symbols.values = (Value*)malloc(INITIAL_SYMBOL_TABLE_SIZE * sizeof(Value));
     vm->symbols.count = 0;
     vm->symbols.capacity = INITIAL_SYMBOL_TABLE_SIZE;
+    initTable(&vm->symbols.slots);
     
-    // Initialize terminal
+    init_output(&vm->output, STDOUT_FILENO, OUTPUT_BUFFER_SIZE);
+
+    // Initialize terminal and fixer
     init_terminal(vm);
+    init_fixer(vm);
     
-    return vm;
+    // Initialize bytecode state
+    vm->chunk = NULL;
+    vm->register_chunk = NULL;
+    vm->stack = (Value*)malloc(STACK_INITIAL * sizeof(Value));
+    if (!vm->stack) {
+        fprintf(stderr, "Failed to allocate VM stack\n");
+        exit(1);
+    }
+    vm->stackTop = vm->stack;
+    vm->stackEnd = vm->stack + STACK_INITIAL;
+    vm->frames = NULL;
+    vm->frame_count = 0;
+    vm->frame_capacity = 0;
+    vm->max_frames = CALL_DEPTH_MAX;
+    vm->objects = NULL;
+    vm->programs = NULL;
+    vm->program_count = 0;
+    vm->program_capacity = 0;
 }
 
-void free_vm(VM* vm) {
-    if (!vm) return;
-    
+// Drop whatever a statement or a failed run left on the stack
+static void reset_stack(VM* vm) {
+    while (vm->stackTop > vm->stack) {
+        release_value(*--vm->stackTop);
+    }
+}
+
+// Grow the stack until slots more values fit above its top. The block may
+// move, so every frame's window is rebased onto it.
+static void grow_stack(VM* vm, int slots) {
+    size_t used = vm->stackTop - vm->stack;
+    size_t capacity = vm->stackEnd - vm->stack;
+    while (capacity - used < (size_t)slots) capacity *= 2;
+
+    uintptr_t old = (uintptr_t)vm->stack;
+    Value* stack = (Value*)realloc(vm->stack, capacity * sizeof(Value));
+    if (!stack) {
+        fprintf(stderr, "Failed to grow VM stack\n");
+        exit(1);
+    }
+    for (int i = 0; i < vm->frame_count; i++) {
+        vm->frames[i].slots = stack + ((uintptr_t)vm->frames[i].slots - old) / sizeof(Value);
+    }
+    vm->stack = stack;
+    vm->stackTop = stack + used;
+    vm->stackEnd = stack + capacity;
+}
+
+// Make room for slots values above the stack top. Frames reserve their
+// chunk's max_stack on entry, so pushes inside a frame need no check.
+static inline void reserve_stack(VM* vm, int slots) {
+    if (vm->stackEnd - vm->stackTop < slots) grow_stack(vm, slots);
+}
+
+// Push an empty frame whose window starts at the stack top, or return NULL
+// at the depth limit. The returned pointer is valid until the next push.
+static CallFrame* push_frame(VM* vm) {
+    if (vm->frame_count >= vm->max_frames) return NULL;
+    if (vm->frame_count == vm->frame_capacity) {
+        int capacity = vm->frame_capacity < 64 ? 64 : vm->frame_capacity * 2;
+        vm->frames = (CallFrame*)realloc(vm->frames, capacity * sizeof(CallFrame));
+        if (!vm->frames) {
+            fprintf(stderr, "Failed to grow call frame stack\n");
+            exit(1);
+        }
+        vm->frame_capacity = capacity;
+    }
+
+    CallFrame* frame = &vm->frames[vm->frame_count++];
+    frame->function = NULL;
+    frame->chunk = NULL;
+    frame->ip = NULL;
+    frame->registers = NULL;
+    frame->pc = NULL;
+    frame->slots = vm->stackTop;
+    frame->body = NULL;
+    frame->next = 0;
+    frame->end = 0;
+    return frame;
+}
+
+void freeVM(VM* vm) {
+    free_output(&vm->output);
+
     // Free heap
     for (int i = 0; i < vm->heap_size; i++) {
         free(vm->heap[i]);
     }
     free(vm->heap);
     
-    // Free stack
+    // Free symbol table (only shared strings are owned; functions point
+    // into the AST or the object list)
+    reset_stack(vm);
     free(vm->stack);
-    
-    // Free symbol table
     for (int i = 0; i < vm->symbols.count; i++) {
-        free(vm->symbols.names[i]);
-        free(vm->symbols.values[i]);
+        release_value(vm->symbols.values[i]);
     }
     free(vm->symbols.names);
     free(vm->symbols.values);
+    freeTable(&vm->symbols.slots);
+    free(vm->frames);
     
-    // Clean up terminal
+    // Clean up terminal and fixer
     free(vm->terminal.current_dir);
+    free_fixer(vm);
     
-    free(vm);
+    // Free bytecode state; compile() leaves its chunk in vm->chunk and
+    // compile_registers() in vm->register_chunk
+    if (vm->chunk) {
+        free_chunk(vm->chunk);
+        free(vm->chunk);
+    }
+    if (vm->register_chunk) {
+        free_register_chunk(vm->register_chunk);
+        free(vm->register_chunk);
+    }
+    freeObjects(vm);
+    for (int i = 0; i < vm->program_count; i++) {
+        free_ast(vm->programs[i]);
+    }
+    free(vm->programs);
+    
+    // Free interned strings last, everything above may point into them
+    free_interner(&vm->strings);
 }
 
 void* vm_alloc(VM* vm, size_t size) {
@@ -90,61 +223,46 @@ void vm_free(VM* vm, void* ptr) {
 }
 
 void push(VM* vm, Value value) {
-    if (vm->stack_size >= vm->stack_capacity) {
-        vm->stack_capacity *= 2;
-        vm->stack = (void**)realloc(vm->stack, vm->stack_capacity * sizeof(void*));
-    }
-    vm->stack[vm->stack_size++] = (void*)value.as.object;
+    reserve_stack(vm, 1);
+    *vm->stackTop++ = value;
 }
 
 Value pop(VM* vm) {
-    if (vm->stack_size == 0) {
-        Value null = {VAL_NULL, {.object = NULL}};
-        return null;
+    if (vm->stackTop == vm->stack) {
+        return NULL_VAL;
     }
-    Value value = {VAL_OBJECT, {.object = vm->stack[--vm->stack_size]}};
-    return value;
+    return *--vm->stackTop;
 }
 
 Value peek(VM* vm, int offset) {
-    if (offset >= vm->stack_size) {
-        Value null = {VAL_NULL, {.object = NULL}};
-        return null;
+    if (offset >= vm->stackTop - vm->stack) {
+        return NULL_VAL;
     }
-    Value value = {VAL_OBJECT, {.object = vm->stack[vm->stack_size - 1 - offset]}};
-    return value;
+    return vm->stackTop[-1 - offset];
 }
 
+// Store value in a global slot, taking over the caller's reference
+static void set_global(VM* vm, int slot, Value value) {
+    release_value(vm->symbols.values[slot]);
+    vm->symbols.values[slot] = value;
+}
+
+// Name-based access, for callers without a resolved node. Defining a name
+// again replaces its value.
 void define_symbol(VM* vm, const char* name, Value value) {
-    if (vm->symbols.count >= vm->symbols.capacity) {
-        vm->symbols.capacity *= 2;
-        vm->symbols.names = (char**)realloc(vm->symbols.names, vm->symbols.capacity * sizeof(char*));
-        vm->symbols.values = (void**)realloc(vm->symbols.values, vm->symbols.capacity * sizeof(void*));
-    }
-    
-    vm->symbols.names[vm->symbols.count] = strdup(name);
-    vm->symbols.values[vm->symbols.count] = value.as.object;
-    vm->symbols.count++;
+    set_global(vm, resolve_global(vm, name), value);
 }
 
 Value get_symbol(VM* vm, const char* name) {
-    for (int i = 0; i < vm->symbols.count; i++) {
-        if (strcmp(vm->symbols.names[i], name) == 0) {
-            Value value = {VAL_OBJECT, {.object = vm->symbols.values[i]}};
-            return value;
-        }
+    Value slot;
+    if (tableGet(&vm->symbols.slots, name, &slot)) {
+        return vm->symbols.values[(int)AS_NUMBER(slot)];
     }
-    Value null = {VAL_NULL, {.object = NULL}};
-    return null;
+    return NULL_VAL;
 }
 
 bool has_symbol(VM* vm, const char* name) {
-    for (int i = 0; i < vm->symbols.count; i++) {
-        if (strcmp(vm->symbols.names[i], name) == 0) {
-            return true;
-        }
-    }
-    return false;
+    return !IS_NULL(get_symbol(vm, name));
 }
 
 void init_terminal(VM* vm) {
@@ -154,6 +272,8 @@ void init_terminal(VM* vm) {
 }
 
 void execute_terminal_command(VM* vm, const char* cmd) {
+    // Commands print through stdio or a child process
+    flush_output(&vm->output);
     if (strncmp(cmd, "cd ", 3) == 0) {
         change_directory(vm, cmd + 3);
     } else if (strcmp(cmd, "ls") == 0) {
@@ -203,58 +323,59 @@ void execute_system_command(VM* vm, const char* cmd) {
 
 Value execute_input_command(VM* vm, const char* prompt) {
     char input[256];
-    printf("%s", prompt);
+    output_write(&vm->output, prompt, strlen(prompt));
+    flush_output(&vm->output);
     fgets(input, sizeof(input), stdin);
     input[strcspn(input, "\n")] = 0; // Remove newline
     
-    Value result;
-    result.type = VAL_STRING;
-    result.as.string = strdup(input);
-    return result;
+    return new_string(input, strlen(input));
 }
 
 Value parse_number(const char* str) {
-    Value result;
-    result.type = VAL_NUMBER;
-    result.as.number = atof(str);
-    return result;
+    // Same leading-whitespace and prefix rules as atof, but decimal input
+    // goes through the lexer's fast path; anything else (inf, nan, hex,
+    // a leading '.') is left to strtod
+    double number;
+    while (isspace((unsigned char)*str)) str++;
+    if (parse_double(str, strlen(str), &number) == 0) {
+        number = strtod(str, NULL);
+    }
+    return canonical_number(number);
 }
 
 Value convert_to_number(Value value) {
-    if (value.type == VAL_NUMBER) {
+    if (IS_NUMBER(value)) {
         return value;
-    } else if (value.type == VAL_STRING) {
-        return parse_number(value.as.string);
+    } else if (IS_STRING(value)) {
+        return parse_number(AS_STRING(value));
     }
-    
-    Value result;
-    result.type = VAL_NUMBER;
-    result.as.number = 0;
-    return result;
+    return NUMBER_VAL(0);
 }
 
 void init_game_engine(VM* vm) {
     // Initialize any game engine state here
+    flush_output(&vm->output);
     printf("\033[2J\033[H"); // Clear screen
 }
 
 void execute_animation(VM* vm, Value animation) {
-    if (animation.type != VAL_ANIMATION) return;
+    if (!IS_ANIMATION(animation)) return;
     
-    Animation anim = animation.as.animation;
-    for (int i = 0; i < anim.repeat; i++) {
+    const ObjAnimation* anim = AS_ANIMATION(animation);
+    flush_output(&vm->output);
+    for (int i = 0; i < anim->repeat; i++) {
         // Move cursor to start position
         printf("\033[%d;%dH", 10, 10);
         
         // Print emoji
-        printf("%s", anim.emoji);
+        printf("%s", anim->emoji);
         fflush(stdout);
         
         // Animate
-        for (int j = 0; j < anim.distance; j++) {
+        for (int j = 0; j < anim->distance; j++) {
             printf("\033[%dC", 1); // Move right
             fflush(stdout);
-            usleep(1000000 / anim.speed); // Delay based on speed
+            usleep(1000000 / anim->speed); // Delay based on speed
         }
         
         // Clear line
@@ -266,263 +387,1130 @@ void render_animation(VM* vm, Value animation) {
     execute_animation(vm, animation);
 }
 
+// The walkers render an animation node as soon as they reach it, so its
+// record lives on the C stack rather than as an object on vm->objects
+static void render_animation_fields(VM* vm, const char* emoji, const char* action,
+                                    int distance, int repeat, int speed) {
+    ObjAnimation record = {{OBJ_ANIMATION, NULL}, emoji, action, distance, repeat, speed};
+    render_animation(vm, OBJ_VAL(&record));
+}
+
+// false and null are falsy, everything else is truthy
+bool is_truthy(Value value) {
+    if (IS_BOOL(value)) return AS_BOOL(value);
+    return !IS_NULL(value);
+}
+
+// Values of different types are never equal. Numbers compare as doubles
+// and strings by content; everything else is equal only to itself.
+bool values_equal(Value a, Value b) {
+    if (IS_NUMBER(a) && IS_NUMBER(b)) return AS_NUMBER(a) == AS_NUMBER(b);
+    if (IS_STRING(a) && IS_STRING(b)) {
+        return a == b || strcmp(AS_STRING(a), AS_STRING(b)) == 0;
+    }
+    return a == b;
+}
+
+// Warn on stderr while a script runs, after the script output so far
+static void runtime_warning(VM* vm, const char* format, ...) {
+    flush_output(&vm->output);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+// Operator semantics shared by the tree walkers; the parser folds literal
+// operands with the same rules
+Value apply_unary(VM* vm, TokenType op, Value operand) {
+    if (op == TOKEN_BANG) {
+        return BOOL_VAL(!is_truthy(operand));
+    } else if (op == TOKEN_MINUS && IS_NUMBER(operand)) {
+        return NUMBER_VAL(-AS_NUMBER(operand));
+    }
+    runtime_warning(vm, "Operand of '%s' must be a number", operator_name(op));
+    return NULL_VAL;
+}
+
+Value apply_binary(VM* vm, TokenType op, Value left, Value right) {
+    if (op == TOKEN_EQ || op == TOKEN_NEQ) {
+        return BOOL_VAL(values_equal(left, right) == (op == TOKEN_EQ));
+    }
+    
+    if (op == TOKEN_PLUS && IS_STRING(left) && IS_STRING(right)) {
+        return concatenate_strings(left, right);
+    }
+    
+    if (!IS_NUMBER(left) || !IS_NUMBER(right)) {
+        runtime_warning(vm, "Operands of '%s' must be numbers", operator_name(op));
+        return NULL_VAL;
+    }
+    
+    double a = AS_NUMBER(left);
+    double b = AS_NUMBER(right);
+    switch (op) {
+        case TOKEN_PLUS: return NUMBER_VAL(a + b);
+        case TOKEN_MINUS: return NUMBER_VAL(a - b);
+        case TOKEN_MULTIPLY: return NUMBER_VAL(a * b);
+        case TOKEN_DIVIDE: return NUMBER_VAL(a / b);
+        case TOKEN_LT: return BOOL_VAL(a < b);
+        case TOKEN_GT: return BOOL_VAL(a > b);
+        case TOKEN_LTE: return BOOL_VAL(a <= b);
+        default: return BOOL_VAL(a >= b);
+    }
+}
+
+// Print the value of a text statement
+void print_text_value(VM* vm, Value value) {
+    if (IS_STRING(value)) {
+        output_line(&vm->output, AS_STRING(value), string_length(value));
+    } else if (IS_NUMBER(value)) {
+        char number[32];
+        int length = snprintf(number, sizeof(number), "%g", AS_NUMBER(value));
+        output_line(&vm->output, number, length);
+    } else if (IS_BOOL(value)) {
+        output_line(&vm->output, AS_BOOL(value) ? "true" : "false", AS_BOOL(value) ? 4 : 5);
+    }
+}
+
 Value evaluate_expression(VM* vm, ASTNode* node) {
     if (!node) {
-        Value null = {VAL_NULL, {.object = NULL}};
-        return null;
+        return NULL_VAL;
     }
 
     switch (node->type) {
         case NODE_NUMBER: {
-            Value value = {VAL_NUMBER, {.number = node->data.number.value}};
-            return value;
+            return NUMBER_VAL(node->data.number.value);
         }
         case NODE_STRING_LITERAL: {
-            Value value = {VAL_STRING, {.string = strdup(node->data.string_literal.value)}};
-            return value;
+            return STRING_VAL(node->data.string_literal.value);
         }
         case NODE_IDENTIFIER: {
-            return get_symbol(vm, node->data.identifier.name);
+            Value value = vm->symbols.values[node_slot(vm, node)];
+            retain_value(value);
+            return value;
         }
         case NODE_TEXT: {
-            Value value = {VAL_STRING, {.string = strdup(node->data.text.content)}};
-            return value;
+            return STRING_VAL(node->data.text.content);
         }
         case NODE_INPUT: {
             return execute_input_command(vm, node->data.input.prompt);
         }
         case NODE_NUMBER_CONVERSION: {
             Value input = evaluate_expression(vm, node->data.number_conversion.expr);
-            return convert_to_number(input);
-        }
-        case NODE_ANIMATION: {
-            Value anim;
-            anim.type = VAL_ANIMATION;
-            anim.as.animation.emoji = strdup(node->data.animation.emoji);
-            anim.as.animation.action = strdup(node->data.animation.action);
-            anim.as.animation.distance = node->data.animation.distance;
-            anim.as.animation.repeat = node->data.animation.repeat;
-            anim.as.animation.speed = node->data.animation.speed;
-            return anim;
+            Value number = convert_to_number(input);
+            release_value(input);
+            return number;
+        }
+        case NODE_BOOLEAN: {
+            return BOOL_VAL(node->data.boolean.value);
+        }
+        case NODE_UNARY: {
+            Value operand = evaluate_expression(vm, node->data.unary.operand);
+            Value result = apply_unary(vm, node->data.unary.op, operand);
+            release_value(operand);
+            return result;
+        }
+        case NODE_BINARY: {
+            Value left = evaluate_expression(vm, node->data.binary.left);
+            Value right = evaluate_expression(vm, node->data.binary.right);
+            Value result = apply_binary(vm, node->data.binary.op, left, right);
+            release_value(left);
+            release_value(right);
+            return result;
         }
         default: {
-            fprintf(stderr, "Unknown expression type: %d\n", node->type);
-            Value null = {VAL_NULL, {.object = NULL}};
-            return null;
+            runtime_warning(vm, "Unknown expression type: %d", node->type);
+            return NULL_VAL;
         }
     }
 }
 
-void execute_statement(VM* vm, ASTNode* node) {
-    if (!node) return;
+// Report a runtime error at line, after the script output so far. Every
+// tier reports its runtime errors this way.
+static void report_runtime_error(VM* vm, int line, const char* format, va_list args) {
+    flush_output(&vm->output);
+    fprintf(stderr, "[line %d] Runtime error: ", line);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+}
+
+// Report a runtime error raised by the walkers at a node's line
+static void walker_error(VM* vm, int line, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    report_runtime_error(vm, line, format, args);
+    va_end(args);
+}
+
+// Body of the function a call statement names, parsed on the first call;
+// NULL if the name is not bound to a function
+static ASTNode* called_body(VM* vm, ASTNode* call) {
+    Value func = vm->symbols.values[node_slot(vm, call)];
+    if (!IS_TREE_DEFINITION(func)) return NULL;
+    return parse_function_body((ASTNode*)AS_DEFINITION(func));
+}
+
+// Run tree-walker frames above base until all of them have returned. A call
+// pushes a frame instead of recursing, and a call in tail position replaces
+// its caller's frame, so neither deep nor endless tail recursion grows the
+// C stack. Returns false after a runtime error, with the frames above base
+// dropped.
+static bool walk_frames(VM* vm, int base) {
+    while (vm->frame_count > base) {
+        CallFrame* frame = &vm->frames[vm->frame_count - 1];
+        int count = frame->body->data.program.statement_count;
+        if (frame->next == count) {
+            vm->frame_count--;
+            continue;
+        }
+
+        ASTNode* statement = frame->body->data.program.statements[frame->next++];
+        if (!statement || statement->type != NODE_IDENTIFIER) {
+            if (!execute_statement(vm, statement)) {
+                vm->frame_count = base;
+                return false;
+            }
+            continue;
+        }
+
+        ASTNode* body = called_body(vm, statement);
+        if (!body) continue;
+        if (frame->next == count) {
+            frame->body = body;
+            frame->next = 0;
+            continue;
+        }
+
+        frame = push_frame(vm);
+        if (!frame) {
+            walker_error(vm, statement->line, "Call depth exceeded in '%s'",
+                         statement->data.identifier.name);
+            vm->frame_count = base;
+            return false;
+        }
+        frame->body = body;
+    }
+    return true;
+}
+
+bool execute_statement(VM* vm, ASTNode* node) {
+    if (!node) return true;
 
     switch (node->type) {
         case NODE_PROGRAM: {
             for (int i = 0; i < node->data.program.statement_count; i++) {
-                execute_statement(vm, node->data.program.statements[i]);
+                if (!execute_statement(vm, node->data.program.statements[i])) return false;
             }
             break;
         }
         case NODE_FUNCTION_DEFINITION: {
             // Store function definition
-            Value func = {VAL_FUNCTION, {.function = node}};
-            define_symbol(vm, node->data.function_definition.name, func);
+            set_global(vm, node_slot(vm, node), DEFINITION_VAL(node));
             break;
         }
         case NODE_TEXT: {
             Value text = evaluate_expression(vm, node->data.text.expr);
-            if (text.type == VAL_STRING) {
-                printf("%s\n", text.as.string);
-            }
+            print_text_value(vm, text);
+            release_value(text);
             break;
         }
         case NODE_IDENTIFIER: {
-            // Look up function and execute it
-            Value func = get_symbol(vm, node->data.identifier.name);
-            if (func.type == VAL_FUNCTION) {
-                ASTNode* func_def = (ASTNode*)func.as.function;
-                execute_statement(vm, func_def->data.function_definition.body);
+            // Look up function and run it in a new frame
+            ASTNode* body = called_body(vm, node);
+            if (!body) break;
+
+            int base = vm->frame_count;
+            CallFrame* frame = push_frame(vm);
+            if (!frame) {
+                walker_error(vm, node->line, "Call depth exceeded in '%s'", node->data.identifier.name);
+                return false;
             }
-            break;
+            frame->body = body;
+            return walk_frames(vm, base);
         }
         case NODE_GAME_ENGINE: {
             init_game_engine(vm);
             for (int i = 0; i < node->data.game_engine.animation_count; i++) {
-                Value anim = evaluate_expression(vm, node->data.game_engine.animations[i]);
-                render_animation(vm, anim);
+                const ASTNode* animation = node->data.game_engine.animations[i];
+                render_animation_fields(vm, animation->data.animation.emoji,
+                                        animation->data.animation.action,
+                                        animation->data.animation.distance,
+                                        animation->data.animation.repeat,
+                                        animation->data.animation.speed);
             }
             break;
         }
+        case NODE_NUMBER:
+        case NODE_STRING_LITERAL:
+        case NODE_BOOLEAN:
+        case NODE_INPUT:
+        case NODE_NUMBER_CONVERSION:
+        case NODE_UNARY:
+        case NODE_BINARY:
+            // Any other expression is evaluated for its effects
+            release_value(evaluate_expression(vm, node));
+            break;
         default:
-            fprintf(stderr, "Unknown statement type: %d\n", node->type);
+            runtime_warning(vm, "Unknown statement type: %d", node->type);
             break;
     }
+    return true;
 }
 
+// Returns 0, or 1 if the program is not a program or stopped on a runtime
+// error
 int execute_program(VM* vm, ASTNode* program) {
     if (!program || program->type != NODE_PROGRAM) {
         fprintf(stderr, "Invalid program node\n");
         return 1;
     }
 
-    for (int i = 0; i < program->data.program.statement_count; i++) {
-        execute_statement(vm, program->data.program.statements[i]);
+    resolve_ast(vm, program);
+    return execute_statement(vm, program) ? 0 : 1;
+}
+
+// Flat AST evaluation: same semantics as the pointer-based walkers, but
+// statement and animation lists are walked as contiguous index ranges.
+// Functions defined here are FLAT_DEFINITION_VAL(FlatNode*), which the
+// pointer walkers do not call, and the other way round.
+Value evaluate_flat_expression(VM* vm, const FlatAST* ast, NodeIndex index) {
+    if (index == NO_NODE) {
+        return NULL_VAL;
+    }
+
+    const FlatNode* node = &ast->nodes[index];
+    switch (node->type) {
+        case NODE_NUMBER: {
+            return NUMBER_VAL(node->data.number.value);
+        }
+        case NODE_STRING_LITERAL: {
+            return STRING_VAL(node->data.string_literal.value);
+        }
+        case NODE_IDENTIFIER: {
+            Value value = get_symbol(vm, node->data.identifier.name);
+            retain_value(value);
+            return value;
+        }
+        case NODE_TEXT: {
+            return STRING_VAL(node->data.text.content);
+        }
+        case NODE_INPUT: {
+            return execute_input_command(vm, node->data.input.prompt);
+        }
+        case NODE_NUMBER_CONVERSION: {
+            Value input = evaluate_flat_expression(vm, ast, node->data.number_conversion.expr);
+            Value number = convert_to_number(input);
+            release_value(input);
+            return number;
+        }
+        case NODE_BOOLEAN: {
+            return BOOL_VAL(node->data.boolean.value);
+        }
+        case NODE_UNARY: {
+            Value operand = evaluate_flat_expression(vm, ast, node->data.unary.operand);
+            Value result = apply_unary(vm, node->data.unary.op, operand);
+            release_value(operand);
+            return result;
+        }
+        case NODE_BINARY: {
+            Value left = evaluate_flat_expression(vm, ast, node->data.binary.left);
+            Value right = evaluate_flat_expression(vm, ast, node->data.binary.right);
+            Value result = apply_binary(vm, node->data.binary.op, left, right);
+            release_value(left);
+            release_value(right);
+            return result;
+        }
+        default: {
+            runtime_warning(vm, "Unknown expression type: %d", node->type);
+            return NULL_VAL;
+        }
     }
-    
-    return 0;
 }
 
-void initVM(VM* vm) {
-    vm->stackTop = vm->stack;
-    vm->globals = NULL;
-    vm->strings = NULL;
-    vm->objects = NULL;
+// Body of the flat function a call statement names, or NULL if the name is
+// not bound to one
+static const FlatNode* called_flat_body(VM* vm, const FlatAST* ast, const FlatNode* call) {
+    Value func = get_symbol(vm, call->data.identifier.name);
+    if (!IS_FLAT_DEFINITION(func)) return NULL;
+    NodeIndex body = ((const FlatNode*)AS_DEFINITION(func))->data.function_definition.body;
+    return body == NO_NODE ? NULL : &ast->nodes[body];
 }
 
-void freeVM(VM* vm) {
-    freeTable(&vm->globals);
-    freeTable(&vm->strings);
-    freeObjects(vm);
+// Flat counterpart of walk_frames: calls push frames instead of recursing,
+// and a call in tail position replaces its caller's frame. Returns false
+// after a runtime error, with the frames above base dropped.
+static bool walk_flat_frames(VM* vm, const FlatAST* ast, int base) {
+    while (vm->frame_count > base) {
+        CallFrame* frame = &vm->frames[vm->frame_count - 1];
+        if (frame->next == frame->end) {
+            vm->frame_count--;
+            continue;
+        }
+
+        NodeIndex index = (NodeIndex)frame->next++;
+        const FlatNode* statement = &ast->nodes[index];
+        if (statement->type != NODE_IDENTIFIER) {
+            if (!execute_flat_statement(vm, ast, index)) {
+                vm->frame_count = base;
+                return false;
+            }
+            continue;
+        }
+
+        const FlatNode* body = called_flat_body(vm, ast, statement);
+        if (!body) continue;
+        if (frame->next != frame->end) {
+            frame = push_frame(vm);
+            if (!frame) {
+                walker_error(vm, statement->line, "Call depth exceeded in '%s'",
+                             statement->data.identifier.name);
+                vm->frame_count = base;
+                return false;
+            }
+        }
+        frame->next = (int)body->data.program.first;
+        frame->end = frame->next + body->data.program.count;
+    }
+    return true;
 }
 
-static InterpretResult run(VM* vm) {
-    #define READ_BYTE() (*vm->ip++)
-    #define READ_CONSTANT() (vm->chunk->constants.values[READ_BYTE()])
-    #define BINARY_OP(valueType, op) \
-        do { \
-            if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) { \
-                runtimeError("Operands must be numbers."); \
-                return INTERPRET_RUNTIME_ERROR; \
-            } \
-            double b = AS_NUMBER(pop()); \
-            double a = AS_NUMBER(pop()); \
-            push(valueType(a op b)); \
-        } while (false)
+bool execute_flat_statement(VM* vm, const FlatAST* ast, NodeIndex index) {
+    if (index == NO_NODE) return true;
 
-    for (;;) {
-        #ifdef DEBUG_TRACE_EXECUTION
-            printf("          ");
-            for (Value* slot = vm->stack; slot < vm->stackTop; slot++) {
-                printf("[ ");
-                printValue(*slot);
-                printf(" ]");
+    const FlatNode* node = &ast->nodes[index];
+    switch (node->type) {
+        case NODE_PROGRAM: {
+            NodeIndex end = node->data.program.first + node->data.program.count;
+            for (NodeIndex i = node->data.program.first; i < end; i++) {
+                if (!execute_flat_statement(vm, ast, i)) return false;
             }
-            printf("\n");
-            disassembleInstruction(vm->chunk, (int)(vm->ip - vm->chunk->code));
-        #endif
-
-        uint8_t instruction;
-        switch (instruction = READ_BYTE()) {
-            case OP_CONSTANT: {
-                Value constant = READ_CONSTANT();
-                push(constant);
-                break;
+            break;
+        }
+        case NODE_FUNCTION_DEFINITION: {
+            // Store function definition
+            define_symbol(vm, node->data.function_definition.name, FLAT_DEFINITION_VAL(node));
+            break;
+        }
+        case NODE_TEXT: {
+            Value text = evaluate_flat_expression(vm, ast, node->data.text.expr);
+            print_text_value(vm, text);
+            release_value(text);
+            break;
+        }
+        case NODE_IDENTIFIER: {
+            // Look up function and run it in a new frame
+            const FlatNode* body = called_flat_body(vm, ast, node);
+            if (!body) break;
+
+            int base = vm->frame_count;
+            CallFrame* frame = push_frame(vm);
+            if (!frame) {
+                walker_error(vm, node->line, "Call depth exceeded in '%s'", node->data.identifier.name);
+                return false;
             }
-            case OP_NULL: push(NULL_VAL); break;
-            case OP_TRUE: push(BOOL_VAL(true)); break;
-            case OP_FALSE: push(BOOL_VAL(false)); break;
-            case OP_POP: pop(); break;
-            case OP_GET_LOCAL: {
-                uint8_t slot = READ_BYTE();
-                push(vm->stack[slot]);
-                break;
+            frame->next = (int)body->data.program.first;
+            frame->end = frame->next + body->data.program.count;
+            return walk_flat_frames(vm, ast, base);
+        }
+        case NODE_GAME_ENGINE: {
+            init_game_engine(vm);
+            NodeIndex first = node->data.game_engine.first_animation;
+            for (int i = 0; i < node->data.game_engine.animation_count; i++) {
+                const FlatNode* animation = &ast->nodes[first + i];
+                render_animation_fields(vm, animation->data.animation.emoji,
+                                        animation->data.animation.action,
+                                        animation->data.animation.distance,
+                                        animation->data.animation.repeat,
+                                        animation->data.animation.speed);
             }
-            case OP_SET_LOCAL: {
-                uint8_t slot = READ_BYTE();
-                vm->stack[slot] = peek(0);
-                break;
+            break;
+        }
+        case NODE_NUMBER:
+        case NODE_STRING_LITERAL:
+        case NODE_BOOLEAN:
+        case NODE_INPUT:
+        case NODE_NUMBER_CONVERSION:
+        case NODE_UNARY:
+        case NODE_BINARY:
+            // Any other expression is evaluated for its effects
+            release_value(evaluate_flat_expression(vm, ast, index));
+            break;
+        default:
+            runtime_warning(vm, "Unknown statement type: %d", node->type);
+            break;
+    }
+    return true;
+}
+
+// Returns 0, or 1 if the program is not a program or stopped on a runtime
+// error
+int execute_flat_program(VM* vm, const FlatAST* ast) {
+    if (ast->root == NO_NODE || ast->nodes[ast->root].type != NODE_PROGRAM) {
+        fprintf(stderr, "Invalid program node\n");
+        return 1;
+    }
+
+    return execute_flat_statement(vm, ast, ast->root) ? 0 : 1;
+}
+// Bytecode execution
+
+// Allocate an object of size bytes and link it into vm->objects
+static Obj* allocate_object(VM* vm, size_t size, ObjType type) {
+    Obj* object = (Obj*)malloc(size);
+    if (!object) {
+        fprintf(stderr, "Failed to allocate memory for object\n");
+        exit(1);
+    }
+    object->type = type;
+    object->next = vm->objects;
+    vm->objects = object;
+    return object;
+}
+
+ObjFunction* new_function(VM* vm, const char* name, ASTNode* definition) {
+    ObjFunction* function = (ObjFunction*)allocate_object(vm, sizeof(ObjFunction), OBJ_FUNCTION);
+    function->name = name;
+    function->definition = definition;
+    function->chunk = NULL;
+    function->registers = NULL;
+    return function;
+}
+
+ObjAnimation* new_animation(VM* vm, const char* emoji, const char* action,
+                            int distance, int repeat, int speed) {
+    ObjAnimation* animation = (ObjAnimation*)allocate_object(vm, sizeof(ObjAnimation), OBJ_ANIMATION);
+    animation->emoji = emoji;
+    animation->action = action;
+    animation->distance = distance;
+    animation->repeat = repeat;
+    animation->speed = speed;
+    return animation;
+}
+
+void freeObjects(VM* vm) {
+    Obj* object = vm->objects;
+    while (object) {
+        Obj* next = object->next;
+        if (object->type == OBJ_FUNCTION) {
+            ObjFunction* function = (ObjFunction*)object;
+            if (function->chunk) {
+                free_chunk(function->chunk);
+                free(function->chunk);
             }
-            case OP_GET_GLOBAL: {
-                ObjString* name = READ_STRING();
-                Value value;
-                if (!tableGet(&vm->globals, name, &value)) {
-                    runtimeError("Undefined variable '%s'.", name->chars);
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                push(value);
-                break;
+            if (function->registers) {
+                free_register_chunk(function->registers);
+                free(function->registers);
             }
-            case OP_DEFINE_GLOBAL: {
-                ObjString* name = READ_STRING();
-                tableSet(&vm->globals, name, peek(0));
-                pop();
-                break;
+        }
+        free(object);
+        object = next;
+    }
+    vm->objects = NULL;
+}
+
+// Keep a parsed tree alive for as long as the VM: function objects point
+// into it, and lazily parsed bodies are added to its arena
+void vm_keep_program(VM* vm, ASTNode* program) {
+    if (vm->program_count >= vm->program_capacity) {
+        vm->program_capacity = vm->program_capacity < 4 ? 4 : vm->program_capacity * 2;
+        vm->programs = (ASTNode**)realloc(vm->programs, vm->program_capacity * sizeof(ASTNode*));
+        if (!vm->programs) {
+            fprintf(stderr, "Failed to allocate memory for program list\n");
+            exit(1);
+        }
+    }
+    vm->programs[vm->program_count++] = program;
+}
+
+// Report an error at the current instruction of the innermost frame
+static void runtime_error(VM* vm, const char* format, ...) {
+    CallFrame* frame = &vm->frames[vm->frame_count - 1];
+    int line;
+    if (frame->registers) {
+        line = frame->registers->lines[frame->pc - frame->registers->code - 1];
+    } else {
+        line = frame->chunk->lines[frame->ip - frame->chunk->code - 1];
+    }
+    va_list args;
+    va_start(args, format);
+    report_runtime_error(vm, line, format, args);
+    va_end(args);
+}
+
+// Run frames above base until the frame at base returns. Calls push a frame
+// and switch chunks in this loop rather than recursing; OP_TAIL_CALL reuses
+// the caller's frame. ip lives in a local and is written back to the frame
+// before anything that reads it there.
+//
+// Operator and type semantics are the tree walker's (apply_unary,
+// apply_binary); the number cases are inlined
+static DISPATCH_LOOP InterpretResult run(VM* vm, int base) {
+    CallFrame* frame = &vm->frames[vm->frame_count - 1];
+    Chunk* chunk = frame->chunk;
+    uint8_t* ip = frame->ip;
+
+    #define READ_BYTE() (*ip++)
+    #define READ_SHORT() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+    #define READ_CONSTANT() (chunk->constants.values[READ_SHORT()])
+    #define READ_SLOT() (ip += 3, (uint32_t)((ip[-3] << 16) | (ip[-2] << 8) | ip[-1]))
+    #define PUSH(value) (*vm->stackTop++ = (value))
+    #define POP() (*--vm->stackTop)
+    #define BINARY_OP(wrap, op, token) \
+        do { \
+            Value b = POP(); \
+            Value a = POP(); \
+            if (IS_NUMBER(a) && IS_NUMBER(b)) { \
+                PUSH(wrap(AS_NUMBER(a) op AS_NUMBER(b))); \
+            } else { \
+                Value result = apply_binary(vm, token, a, b); \
+                release_value(a); \
+                release_value(b); \
+                PUSH(result); \
+            } \
+        } while (false)
+    // Arithmetic with a constant right operand, in place on the stack top.
+    // Constants are never counted strings, so only the left is released.
+    #define CONSTANT_OP(op, token) \
+        do { \
+            Value b = READ_CONSTANT(); \
+            Value a = vm->stackTop[-1]; \
+            if (IS_NUMBER(a) && IS_NUMBER(b)) { \
+                vm->stackTop[-1] = NUMBER_VAL(AS_NUMBER(a) op AS_NUMBER(b)); \
+            } else { \
+                vm->stackTop[-1] = apply_binary(vm, token, a, b); \
+                release_value(a); \
+            } \
+        } while (false)
+
+    // Calls and returns move ip elsewhere, so a pair is only counted when
+    // its first instruction falls through to the second
+#ifdef VM_PROFILE_PAIRS
+    #define FETCH() \
+        (instruction != OP_CALL && instruction != OP_TAIL_CALL && instruction != OP_RETURN && \
+         instruction != OP_CALL_GLOBAL && instruction != OP_TAIL_CALL_GLOBAL \
+             ? opcode_pair_counts[instruction][*ip]++ : 0, \
+         COUNT_INSTRUCTION(), instruction = READ_BYTE())
+#else
+    #define FETCH() (COUNT_INSTRUCTION(), instruction = READ_BYTE())
+#endif
+
+    uint8_t instruction = OP_RETURN;
+    ObjFunction* function;
+#ifdef VM_THREADED_DISPATCH
+    // Every handler ends in its own indirect jump through this table, so
+    // the branch predictor sees each opcode's successors separately. Bytes
+    // that are not opcodes land on the unknown handler, so there is no
+    // range check.
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Woverride-init"
+    static void* dispatch_table[256] = {
+        [0 ... 255] = &&op_unknown,
+        [OP_CONSTANT] = &&op_OP_CONSTANT,
+        [OP_NULL] = &&op_OP_NULL,
+        [OP_TRUE] = &&op_OP_TRUE,
+        [OP_FALSE] = &&op_OP_FALSE,
+        [OP_POP] = &&op_OP_POP,
+        [OP_GET_GLOBAL] = &&op_OP_GET_GLOBAL,
+        [OP_DEFINE_GLOBAL] = &&op_OP_DEFINE_GLOBAL,
+        [OP_EQUAL] = &&op_OP_EQUAL,
+        [OP_GREATER] = &&op_OP_GREATER,
+        [OP_LESS] = &&op_OP_LESS,
+        [OP_GREATER_EQUAL] = &&op_OP_GREATER_EQUAL,
+        [OP_LESS_EQUAL] = &&op_OP_LESS_EQUAL,
+        [OP_ADD] = &&op_OP_ADD,
+        [OP_SUBTRACT] = &&op_OP_SUBTRACT,
+        [OP_MULTIPLY] = &&op_OP_MULTIPLY,
+        [OP_DIVIDE] = &&op_OP_DIVIDE,
+        [OP_NOT] = &&op_OP_NOT,
+        [OP_NEGATE] = &&op_OP_NEGATE,
+        [OP_PRINT] = &&op_OP_PRINT,
+        [OP_INPUT] = &&op_OP_INPUT,
+        [OP_TO_NUMBER] = &&op_OP_TO_NUMBER,
+        [OP_GAME_ENGINE] = &&op_OP_GAME_ENGINE,
+        [OP_ANIMATE] = &&op_OP_ANIMATE,
+        [OP_CALL] = &&op_OP_CALL,
+        [OP_TAIL_CALL] = &&op_OP_TAIL_CALL,
+        [OP_RETURN] = &&op_OP_RETURN,
+        [OP_CALL_GLOBAL] = &&op_OP_CALL_GLOBAL,
+        [OP_TAIL_CALL_GLOBAL] = &&op_OP_TAIL_CALL_GLOBAL,
+        [OP_PRINT_CONSTANT] = &&op_OP_PRINT_CONSTANT,
+        [OP_ADD_CONSTANT] = &&op_OP_ADD_CONSTANT,
+        [OP_SUBTRACT_CONSTANT] = &&op_OP_SUBTRACT_CONSTANT,
+        [OP_MULTIPLY_CONSTANT] = &&op_OP_MULTIPLY_CONSTANT,
+        [OP_DIVIDE_CONSTANT] = &&op_OP_DIVIDE_CONSTANT,
+    };
+    #pragma GCC diagnostic pop
+    #define INSTRUCTION(op) op_##op:
+    #define INSTRUCTION_UNKNOWN op_unknown:
+    #define NEXT() goto *dispatch_table[FETCH()]
+
+    NEXT();
+#else
+    #define INSTRUCTION(op) case op:
+    #define INSTRUCTION_UNKNOWN default:
+    #define NEXT() continue
+
+    for (;;) switch (FETCH())
+#endif
+    {
+        INSTRUCTION(OP_CONSTANT) {
+            Value constant = READ_CONSTANT();
+            PUSH(constant);
+            NEXT();
+        }
+        INSTRUCTION(OP_NULL)
+            PUSH(NULL_VAL);
+            NEXT();
+        INSTRUCTION(OP_TRUE)
+            PUSH(TRUE_VAL);
+            NEXT();
+        INSTRUCTION(OP_FALSE)
+            PUSH(FALSE_VAL);
+            NEXT();
+        INSTRUCTION(OP_POP)
+            release_value(POP());
+            NEXT();
+        INSTRUCTION(OP_GET_GLOBAL) {
+            // Undefined slots hold null, as in the tree walker
+            Value value = vm->symbols.values[READ_SLOT()];
+            retain_value(value);
+            PUSH(value);
+            NEXT();
+        }
+        INSTRUCTION(OP_DEFINE_GLOBAL) {
+            uint32_t slot = READ_SLOT();
+            set_global(vm, (int)slot, POP());
+            NEXT();
+        }
+        INSTRUCTION(OP_EQUAL) {
+            Value b = POP();
+            Value a = POP();
+            bool equal = values_equal(a, b);
+            release_value(a);
+            release_value(b);
+            PUSH(BOOL_VAL(equal));
+            NEXT();
+        }
+        INSTRUCTION(OP_GREATER)       BINARY_OP(BOOL_VAL, >, TOKEN_GT); NEXT();
+        INSTRUCTION(OP_LESS)          BINARY_OP(BOOL_VAL, <, TOKEN_LT); NEXT();
+        INSTRUCTION(OP_GREATER_EQUAL) BINARY_OP(BOOL_VAL, >=, TOKEN_GTE); NEXT();
+        INSTRUCTION(OP_LESS_EQUAL)    BINARY_OP(BOOL_VAL, <=, TOKEN_LTE); NEXT();
+        INSTRUCTION(OP_ADD)           BINARY_OP(NUMBER_VAL, +, TOKEN_PLUS); NEXT();
+        INSTRUCTION(OP_SUBTRACT)      BINARY_OP(NUMBER_VAL, -, TOKEN_MINUS); NEXT();
+        INSTRUCTION(OP_MULTIPLY)      BINARY_OP(NUMBER_VAL, *, TOKEN_MULTIPLY); NEXT();
+        INSTRUCTION(OP_DIVIDE)        BINARY_OP(NUMBER_VAL, /, TOKEN_DIVIDE); NEXT();
+        INSTRUCTION(OP_ADD_CONSTANT)      CONSTANT_OP(+, TOKEN_PLUS); NEXT();
+        INSTRUCTION(OP_SUBTRACT_CONSTANT) CONSTANT_OP(-, TOKEN_MINUS); NEXT();
+        INSTRUCTION(OP_MULTIPLY_CONSTANT) CONSTANT_OP(*, TOKEN_MULTIPLY); NEXT();
+        INSTRUCTION(OP_DIVIDE_CONSTANT)   CONSTANT_OP(/, TOKEN_DIVIDE); NEXT();
+        INSTRUCTION(OP_NOT) {
+            Value operand = POP();
+            bool falsy = !is_truthy(operand);
+            release_value(operand);
+            PUSH(BOOL_VAL(falsy));
+            NEXT();
+        }
+        INSTRUCTION(OP_NEGATE) {
+            Value operand = POP();
+            if (IS_NUMBER(operand)) {
+                PUSH(NUMBER_VAL(-AS_NUMBER(operand)));
+            } else {
+                Value result = apply_unary(vm, TOKEN_MINUS, operand);
+                release_value(operand);
+                PUSH(result);
             }
-            case OP_SET_GLOBAL: {
-                ObjString* name = READ_STRING();
-                if (tableSet(&vm->globals, name, peek(0))) {
-                    tableDelete(&vm->globals, name);
-                    runtimeError("Undefined variable '%s'.", name->chars);
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                break;
+            NEXT();
+        }
+        INSTRUCTION(OP_PRINT_CONSTANT)
+            print_text_value(vm, READ_CONSTANT());
+            NEXT();
+        INSTRUCTION(OP_PRINT) {
+            Value value = POP();
+            print_text_value(vm, value);
+            release_value(value);
+            NEXT();
+        }
+        INSTRUCTION(OP_INPUT) {
+            const char* prompt = AS_STRING(READ_CONSTANT());
+            PUSH(execute_input_command(vm, prompt));
+            NEXT();
+        }
+        INSTRUCTION(OP_TO_NUMBER) {
+            Value input = POP();
+            Value number = convert_to_number(input);
+            release_value(input);
+            PUSH(number);
+            NEXT();
+        }
+        INSTRUCTION(OP_GAME_ENGINE)
+            init_game_engine(vm);
+            NEXT();
+        INSTRUCTION(OP_ANIMATE)
+            render_animation(vm, POP());
+            NEXT();
+        INSTRUCTION(OP_CALL_GLOBAL)
+        INSTRUCTION(OP_TAIL_CALL_GLOBAL) {
+            Value callee = vm->symbols.values[READ_SLOT()];
+            if (!IS_FUNCTION(callee)) NEXT();
+            function = AS_FUNCTION(callee);
+            goto call;
+        }
+        INSTRUCTION(OP_CALL)
+        INSTRUCTION(OP_TAIL_CALL) {
+            // Calling anything but a function does nothing
+            Value callee = POP();
+            if (!IS_FUNCTION(callee)) {
+                release_value(callee);
+                NEXT();
             }
-            case OP_EQUAL: {
-                Value b = pop();
-                Value a = pop();
-                push(BOOL_VAL(valuesEqual(a, b)));
-                break;
+            function = AS_FUNCTION(callee);
+
+        call:
+            frame->ip = ip;
+            if (!function->chunk && !compile_function(vm, function, true)) {
+                return INTERPRET_COMPILE_ERROR;
             }
-            case OP_GREATER:  BINARY_OP(BOOL_VAL, >); break;
-            case OP_LESS:     BINARY_OP(BOOL_VAL, <); break;
-            case OP_ADD:      BINARY_OP(NUMBER_VAL, +); break;
-            case OP_SUBTRACT: BINARY_OP(NUMBER_VAL, -); break;
-            case OP_MULTIPLY: BINARY_OP(NUMBER_VAL, *); break;
-            case OP_DIVIDE:   BINARY_OP(NUMBER_VAL, /); break;
-            case OP_NOT:
-                push(BOOL_VAL(isFalsey(pop())));
-                break;
-            case OP_NEGATE:
-                if (!IS_NUMBER(peek(0))) {
-                    runtimeError("Operand must be a number.");
+            reserve_stack(vm, function->chunk->max_stack);
+            if (instruction == OP_CALL || instruction == OP_CALL_GLOBAL) {
+                frame = push_frame(vm);
+                if (!frame) {
+                    frame = &vm->frames[vm->frame_count - 1];
+                    runtime_error(vm, "Call depth exceeded in '%s'", function->name);
                     return INTERPRET_RUNTIME_ERROR;
                 }
-                push(NUMBER_VAL(-AS_NUMBER(pop())));
-                break;
-            case OP_PRINT: {
-                printValue(pop());
-                printf("\n");
-                break;
             }
-            case OP_JUMP: {
-                uint16_t offset = READ_SHORT();
-                vm->ip += offset;
-                break;
+            frame->function = function;
+            frame->chunk = function->chunk;
+            frame->slots = vm->stackTop;
+            chunk = function->chunk;
+            ip = chunk->code;
+            NEXT();
+        }
+        INSTRUCTION(OP_RETURN)
+            if (--vm->frame_count == base) return INTERPRET_OK;
+            frame = &vm->frames[vm->frame_count - 1];
+            chunk = frame->chunk;
+            ip = frame->ip;
+            NEXT();
+        INSTRUCTION_UNKNOWN
+            frame->ip = ip;
+            runtime_error(vm, "Unknown opcode %d", instruction);
+            return INTERPRET_RUNTIME_ERROR;
+    }
+
+    #undef READ_BYTE
+    #undef READ_SHORT
+    #undef READ_CONSTANT
+    #undef READ_SLOT
+    #undef PUSH
+    #undef POP
+    #undef BINARY_OP
+    #undef CONSTANT_OP
+    #undef INSTRUCTION
+    #undef INSTRUCTION_UNKNOWN
+    #undef NEXT
+    #undef FETCH
+}
+
+// Run chunk from its first instruction to its OP_RETURN in a new frame.
+// Frames a failed run leaves behind are dropped.
+InterpretResult run_chunk(VM* vm, Chunk* chunk) {
+    int base = vm->frame_count;
+    reserve_stack(vm, chunk->max_stack);
+    CallFrame* frame = push_frame(vm);
+    if (!frame) {
+        runtime_warning(vm, "Call depth exceeded");
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    frame->chunk = chunk;
+    frame->ip = chunk->code;
+
+    InterpretResult result = run(vm, base);
+    vm->frame_count = base;
+    return result;
+}
+
+// Make the first count registers of the window at offset base part of the
+// stack, null-initialized. Windows only ever raise the stack top, which
+// releases them when the run ends. The stack may move.
+static void reserve_registers(VM* vm, size_t base, int count) {
+    size_t top = vm->stackTop - vm->stack;
+    if (base + count <= top) return;
+    reserve_stack(vm, (int)(base + count - top));
+    while (vm->stackTop < vm->stack + base + count) *vm->stackTop++ = NULL_VAL;
+}
+
+// Register tier counterpart of run(). Instructions read their operands in
+// place, from a register or straight from the constant pool, and write
+// their result into a register, so an operator is one instruction rather
+// than the pushes of its operands plus the operator itself. Registers own
+// their values; a write releases the value it replaces.
+static DISPATCH_LOOP InterpretResult run_registers(VM* vm, int base) {
+    CallFrame* frame = &vm->frames[vm->frame_count - 1];
+    RegisterChunk* chunk = frame->registers;
+    uint32_t* pc = frame->pc;
+    Value* registers = frame->slots;
+    Value* constants = chunk->constants.values;
+
+    #define RK(operand) \
+        ((operand) < RK_CONSTANT ? registers[operand] : constants[(operand) - RK_CONSTANT])
+    #define RKB() RK(DECODE_B(word))
+    #define RKC() RK(DECODE_C(word))
+    #define STORE(value) \
+        do { \
+            Value result = (value); \
+            Value* target = &registers[DECODE_A(word)]; \
+            release_value(*target); \
+            *target = result; \
+        } while (false)
+    // Operators replace their left or only operand, a, in R[A]; numbers
+    // need no release, so the arithmetic fast path skips it
+    #define IN_PLACE(expression) \
+        do { \
+            Value* target = &registers[DECODE_A(word)]; \
+            Value a = *target; \
+            *target = (expression); \
+            release_value(a); \
+        } while (false)
+    #define BINARY_OP(wrap, op, token) \
+        do { \
+            Value* target = &registers[DECODE_A(word)]; \
+            Value a = *target; \
+            Value c = RKC(); \
+            if (IS_NUMBER(a) && IS_NUMBER(c)) { \
+                *target = wrap(AS_NUMBER(a) op AS_NUMBER(c)); \
+            } else { \
+                *target = apply_binary(vm, token, a, c); \
+                release_value(a); \
+            } \
+        } while (false)
+    #define FETCH() (COUNT_INSTRUCTION(), word = *pc++, DECODE_OP(word))
+
+    uint32_t word = ROP_RETURN;
+    ObjFunction* function;
+#ifdef VM_THREADED_DISPATCH
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Woverride-init"
+    static void* dispatch_table[256] = {
+        [0 ... 255] = &&op_unknown,
+        [ROP_LOAD_CONSTANT] = &&op_ROP_LOAD_CONSTANT,
+        [ROP_GET_GLOBAL] = &&op_ROP_GET_GLOBAL,
+        [ROP_DEFINE_GLOBAL] = &&op_ROP_DEFINE_GLOBAL,
+        [ROP_EQUAL] = &&op_ROP_EQUAL,
+        [ROP_NOT_EQUAL] = &&op_ROP_NOT_EQUAL,
+        [ROP_GREATER] = &&op_ROP_GREATER,
+        [ROP_LESS] = &&op_ROP_LESS,
+        [ROP_GREATER_EQUAL] = &&op_ROP_GREATER_EQUAL,
+        [ROP_LESS_EQUAL] = &&op_ROP_LESS_EQUAL,
+        [ROP_ADD] = &&op_ROP_ADD,
+        [ROP_SUBTRACT] = &&op_ROP_SUBTRACT,
+        [ROP_MULTIPLY] = &&op_ROP_MULTIPLY,
+        [ROP_DIVIDE] = &&op_ROP_DIVIDE,
+        [ROP_NOT] = &&op_ROP_NOT,
+        [ROP_NEGATE] = &&op_ROP_NEGATE,
+        [ROP_TO_NUMBER] = &&op_ROP_TO_NUMBER,
+        [ROP_INPUT] = &&op_ROP_INPUT,
+        [ROP_PRINT] = &&op_ROP_PRINT,
+        [ROP_GAME_ENGINE] = &&op_ROP_GAME_ENGINE,
+        [ROP_ANIMATE] = &&op_ROP_ANIMATE,
+        [ROP_CALL_GLOBAL] = &&op_ROP_CALL_GLOBAL,
+        [ROP_TAIL_CALL_GLOBAL] = &&op_ROP_TAIL_CALL_GLOBAL,
+        [ROP_RETURN] = &&op_ROP_RETURN,
+    };
+    #pragma GCC diagnostic pop
+    #define INSTRUCTION(op) op_##op:
+    #define INSTRUCTION_UNKNOWN op_unknown:
+    #define NEXT() goto *dispatch_table[FETCH()]
+
+    NEXT();
+#else
+    #define INSTRUCTION(op) case op:
+    #define INSTRUCTION_UNKNOWN default:
+    #define NEXT() continue
+
+    for (;;) switch (FETCH())
+#endif
+    {
+        INSTRUCTION(ROP_LOAD_CONSTANT)
+            STORE(constants[DECODE_BX(word)]);
+            NEXT();
+        INSTRUCTION(ROP_GET_GLOBAL) {
+            // Undefined slots hold null, as in the tree walker
+            Value value = vm->symbols.values[*pc++];
+            retain_value(value);
+            STORE(value);
+            NEXT();
+        }
+        INSTRUCTION(ROP_DEFINE_GLOBAL) {
+            // A register's value moves into the global
+            int operand = DECODE_B(word);
+            if (operand < RK_CONSTANT) {
+                set_global(vm, (int)*pc++, registers[operand]);
+                registers[operand] = NULL_VAL;
+            } else {
+                set_global(vm, (int)*pc++, constants[operand - RK_CONSTANT]);
             }
-            case OP_JUMP_IF_FALSE: {
-                uint16_t offset = READ_SHORT();
-                if (isFalsey(peek(0))) vm->ip += offset;
-                break;
+            NEXT();
+        }
+        INSTRUCTION(ROP_EQUAL)         IN_PLACE(BOOL_VAL(values_equal(a, RKC()))); NEXT();
+        INSTRUCTION(ROP_NOT_EQUAL)     IN_PLACE(BOOL_VAL(!values_equal(a, RKC()))); NEXT();
+        INSTRUCTION(ROP_GREATER)       BINARY_OP(BOOL_VAL, >, TOKEN_GT); NEXT();
+        INSTRUCTION(ROP_LESS)          BINARY_OP(BOOL_VAL, <, TOKEN_LT); NEXT();
+        INSTRUCTION(ROP_GREATER_EQUAL) BINARY_OP(BOOL_VAL, >=, TOKEN_GTE); NEXT();
+        INSTRUCTION(ROP_LESS_EQUAL)    BINARY_OP(BOOL_VAL, <=, TOKEN_LTE); NEXT();
+        INSTRUCTION(ROP_ADD)           BINARY_OP(NUMBER_VAL, +, TOKEN_PLUS); NEXT();
+        INSTRUCTION(ROP_SUBTRACT)      BINARY_OP(NUMBER_VAL, -, TOKEN_MINUS); NEXT();
+        INSTRUCTION(ROP_MULTIPLY)      BINARY_OP(NUMBER_VAL, *, TOKEN_MULTIPLY); NEXT();
+        INSTRUCTION(ROP_DIVIDE)        BINARY_OP(NUMBER_VAL, /, TOKEN_DIVIDE); NEXT();
+        INSTRUCTION(ROP_NOT)           IN_PLACE(BOOL_VAL(!is_truthy(a))); NEXT();
+        INSTRUCTION(ROP_NEGATE)
+            IN_PLACE(IS_NUMBER(a) ? NUMBER_VAL(-AS_NUMBER(a)) : apply_unary(vm, TOKEN_MINUS, a));
+            NEXT();
+        INSTRUCTION(ROP_TO_NUMBER)     IN_PLACE(convert_to_number(a)); NEXT();
+        INSTRUCTION(ROP_INPUT)
+            STORE(execute_input_command(vm, AS_STRING(constants[DECODE_BX(word)])));
+            NEXT();
+        INSTRUCTION(ROP_PRINT)         print_text_value(vm, RKB()); NEXT();
+        INSTRUCTION(ROP_GAME_ENGINE)   init_game_engine(vm); NEXT();
+        INSTRUCTION(ROP_ANIMATE)       render_animation(vm, RKB()); NEXT();
+        INSTRUCTION(ROP_CALL_GLOBAL)
+        INSTRUCTION(ROP_TAIL_CALL_GLOBAL) {
+            // Calling anything but a function does nothing
+            Value callee = vm->symbols.values[DECODE_SX(word)];
+            if (!IS_FUNCTION(callee)) NEXT();
+            function = AS_FUNCTION(callee);
+
+            frame->pc = pc;
+            if (!function->registers && !compile_register_function(vm, function, true)) {
+                return INTERPRET_COMPILE_ERROR;
             }
-            case OP_LOOP: {
-                uint16_t offset = READ_SHORT();
-                vm->ip -= offset;
-                break;
+            // The callee's window usually fits in what is already reserved
+            if (registers + function->registers->register_count > vm->stackTop) {
+                reserve_registers(vm, registers - vm->stack, function->registers->register_count);
+                registers = frame->slots;
             }
-            case OP_CALL: {
-                int argCount = READ_BYTE();
-                if (!callValue(peek(argCount), argCount)) {
+            if (DECODE_OP(word) == ROP_CALL_GLOBAL) {
+                frame = push_frame(vm);
+                if (!frame) {
+                    frame = &vm->frames[vm->frame_count - 1];
+                    runtime_error(vm, "Call depth exceeded in '%s'", function->name);
                     return INTERPRET_RUNTIME_ERROR;
                 }
-                break;
-            }
-            case OP_RETURN: {
-                return INTERPRET_OK;
+                frame->slots = registers;
             }
+            frame->function = function;
+            frame->registers = function->registers;
+            chunk = function->registers;
+            constants = chunk->constants.values;
+            pc = chunk->code;
+            NEXT();
         }
+        INSTRUCTION(ROP_RETURN)
+            if (--vm->frame_count == base) return INTERPRET_OK;
+            frame = &vm->frames[vm->frame_count - 1];
+            chunk = frame->registers;
+            constants = chunk->constants.values;
+            pc = frame->pc;
+            registers = frame->slots;
+            NEXT();
+        INSTRUCTION_UNKNOWN
+            frame->pc = pc;
+            runtime_error(vm, "Unknown opcode %d", DECODE_OP(word));
+            return INTERPRET_RUNTIME_ERROR;
     }
 
-    #undef READ_BYTE
-    #undef READ_CONSTANT
+    #undef RK
+    #undef RKB
+    #undef RKC
+    #undef STORE
+    #undef IN_PLACE
     #undef BINARY_OP
+    #undef INSTRUCTION
+    #undef INSTRUCTION_UNKNOWN
+    #undef NEXT
+    #undef FETCH
 }
 
-InterpretResult interpret(VM* vm, const char* source) {
-    compile(vm, source);
-    if (vm->parser->hadError) return INTERPRET_COMPILE_ERROR;
+// Run register code from its first instruction to its ROP_RETURN in a new
+// frame, with a register window at the stack top
+InterpretResult run_register_chunk(VM* vm, RegisterChunk* chunk) {
+    int base = vm->frame_count;
+    size_t window = vm->stackTop - vm->stack;
+    CallFrame* frame = push_frame(vm);
+    if (!frame) {
+        runtime_warning(vm, "Call depth exceeded");
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    frame->registers = chunk;
+    frame->pc = chunk->code;
+    reserve_registers(vm, window, chunk->register_count);
 
-    vm->ip = vm->chunk->code;
-    return run(vm);
+    InterpretResult result = run_registers(vm, base);
+    vm->frame_count = base;
+    while (vm->stackTop > vm->stack + window) release_value(*--vm->stackTop);
+    return result;
+}
+
+// State for interpret(): each top-level statement is compiled into a fresh
+// script chunk and run as soon as the parser hands it over
+typedef struct {
+    VM* vm;
+    Parser* parser;
+    Compiler compiler;
+    Chunk script;
+    InterpretResult result;
+} ScriptRun;
+
+static void run_parsed_statement(ASTNode* statement, void* arg) {
+    ScriptRun* script = (ScriptRun*)arg;
+    if (script->result != INTERPRET_OK) return;
+
+    // Start from an empty chunk; functions and globals outlive it
+    script->script.count = 0;
+    script->script.constants.count = 0;
+    freeTable(&script->compiler.string_constants);
+    script->compiler.last_call = -1;
+
+    resolve_ast(script->vm, statement);
+    compile_statement(&script->compiler, statement);
+    emit_return(&script->compiler, statement->line);
+    if (script->compiler.had_error) {
+        script->result = INTERPRET_COMPILE_ERROR;
+    } else {
+        script->result = run_chunk(script->vm, &script->script);
+        reset_stack(script->vm);
+    }
+
+    // Stop the parser after an error
+    if (script->result != INTERPRET_OK) script->parser->had_error = 1;
+}
+
+InterpretResult interpret(VM* vm, const char* source, size_t length) {
+    Lexer lexer;
+    init_lexer(&lexer, source, length);
+    Parser* parser = create_parser(&lexer, &vm->strings);
+    if (!parser) return INTERPRET_COMPILE_ERROR;
+    parser->lazy_functions = true;
+
+    ScriptRun script;
+    script.vm = vm;
+    script.parser = parser;
+    script.result = INTERPRET_OK;
+    init_chunk(&script.script);
+    init_compiler(&script.compiler, vm, &script.script, true);
+
+    ASTNode* program = parse_program_streaming(parser, run_parsed_statement, &script);
+
+    InterpretResult result = script.result;
+    if (result == INTERPRET_OK && parser->had_error) result = INTERPRET_COMPILE_ERROR;
+
+    vm_keep_program(vm, program);
+    free_compiler(&script.compiler);
+    free_chunk(&script.script);
+    free_parser(parser);
+    return result;
 }
 
 void init_fixer(VM* vm) {
@@ -583,7 +1571,8 @@ void analyze_code(VM* vm, const char* source) {
         // Check for undefined variables
         char* var = strtok(line, " =;");
         while (var != NULL) {
-            if (isalpha(var[0]) && !has_symbol(vm, var)) {
+            const char* name = intern_find(&vm->strings, var, strlen(var));
+            if (isalpha(var[0]) && (!name || !has_symbol(vm, name))) {
                 add_fix(vm, FIX_UNDEFINED_VARIABLE, line_number, var - line,
                        "Undefined variable used",
                        strcat(strdup("var "), var));
@@ -628,6 +1617,7 @@ void apply_fixes(VM* vm, const char* source, char** fixed_source) {
 }
 
 void print_fixes(VM* vm) {
+    flush_output(&vm->output);
     printf("\nFound %d issues:\n", vm->fixer.fix_count);
     for (int i = 0; i < vm->fixer.fix_count; i++) {
         CodeFix* fix = &vm->fixer.fixes[i];
@@ -636,49 +1626,92 @@ void print_fixes(VM* vm) {
     }
 }
 
-void compile(VM* vm, const char* source) {
-    // First analyze the code
-    analyze_code(vm, source);
+// Parse all of source, resolving its names. The tree is kept by the VM;
+// returns NULL on a syntax error. The whole file is needed anyway, so it
+// is lexed up front and parsed from the token buffer. A file large enough
+// to split is lexed, and its top-level functions parsed, on a thread pool
+// if there is more than one CPU to run it on.
+static ASTNode* parse_for_compile(VM* vm, const char* source) {
+    size_t length = strlen(source);
+    Lexer lexer;
+    init_lexer(&lexer, source, length);
 
-    // If there are fixes, apply them
-    if (vm->fixer.fix_count > 0) {
-        printf("Found issues in your code. Applying fixes...\n");
-        print_fixes(vm);
-        
-        char* fixed_source;
-        apply_fixes(vm, source, &fixed_source);
-        
-        // Compile the fixed source
-        Parser parser;
-        initParser(&parser, fixed_source);
-        Compiler compiler;
-        initCompiler(&compiler, &parser);
+    ThreadPool* pool = NULL;
+    Parser* parser;
+    if (length >= PARALLEL_LEX_MIN_SOURCE && sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+        pool = create_thread_pool(0);
+        parser = create_parser_from_tokens(&lexer, tokenize_parallel(source, length, pool),
+                                           &vm->strings);
+    } else {
+        parser = create_buffered_parser(&lexer, &vm->strings);
+    }
+    if (!parser) {
+        free_thread_pool(pool);
+        return NULL;
+    }
+    parser->pool = pool;
 
-        parser.hadError = false;
-        parser.panicMode = false;
+    ASTNode* program = parse_program(parser);
+    bool ok = !parser->had_error;
+    free_parser(parser);
+    free_thread_pool(pool);
+    vm_keep_program(vm, program);
+    if (!ok) return NULL;
 
-        while (!match(&parser, TOKEN_EOF)) {
-            declaration(&compiler);
-        }
+    resolve_ast(vm, program);
+    return program;
+}
+
+bool compile(VM* vm, const char* source) {
+    ASTNode* program = parse_for_compile(vm, source);
+    if (!program) return false;
 
-        endCompiler(&compiler);
-        free(fixed_source);
-        return !parser.hadError;
+    // Every function body is compiled up front so the chunk is complete
+    if (vm->chunk) {
+        free_chunk(vm->chunk);
+        free(vm->chunk);
+    }
+    vm->chunk = (Chunk*)malloc(sizeof(Chunk));
+    if (!vm->chunk) {
+        fprintf(stderr, "Failed to allocate memory for chunk\n");
+        exit(1);
     }
+    init_chunk(vm->chunk);
 
-    // If no fixes needed, compile normally
-    Parser parser;
-    initParser(&parser, source);
     Compiler compiler;
-    initCompiler(&compiler, &parser);
+    init_compiler(&compiler, vm, vm->chunk, false);
+    bool ok = compile_program(&compiler, program);
+    free_compiler(&compiler);
+    return ok;
+}
 
-    parser.hadError = false;
-    parser.panicMode = false;
+bool compile_registers(VM* vm, const char* source) {
+    ASTNode* program = parse_for_compile(vm, source);
+    if (!program) return false;
 
-    while (!match(&parser, TOKEN_EOF)) {
-        declaration(&compiler);
+    if (vm->register_chunk) {
+        free_register_chunk(vm->register_chunk);
+        free(vm->register_chunk);
+    }
+    vm->register_chunk = (RegisterChunk*)malloc(sizeof(RegisterChunk));
+    if (!vm->register_chunk) {
+        fprintf(stderr, "Failed to allocate memory for register chunk\n");
+        exit(1);
     }
+    init_register_chunk(vm->register_chunk);
 
-    endCompiler(&compiler);
-    return !parser.hadError;
-} 
\ No newline at end of file
+    RegisterCompiler compiler;
+    init_register_compiler(&compiler, vm, vm->register_chunk, false);
+    return compile_register_program(&compiler, program);
+}
+
+InterpretResult interpret_flat(VM* vm, const char* source) {
+    ASTNode* program = parse_for_compile(vm, source);
+    if (!program) return INTERPRET_COMPILE_ERROR;
+
+    FlatAST* ast = flatten_ast(program);
+    if (!ast) return INTERPRET_COMPILE_ERROR;
+    int status = execute_flat_program(vm, ast);
+    free_flat_ast(ast);
+    return status == 0 ? INTERPRET_OK : INTERPRET_RUNTIME_ERROR;
+}
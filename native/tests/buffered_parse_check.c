@@ -0,0 +1,96 @@
+// Buffered parse check: every source is parsed once from the lexer
+// (streaming) and once from a token buffer, eagerly and with lazy function
+// bodies, and the two must produce the same tree, the same outcome and the
+// same diagnostics. The cases lean on the IDENTIFIER {num} lookahead,
+// which reads ahead of the current token, and on skipping lazy bodies.
+#include "check.h"
+
+typedef struct {
+    const char* name;
+    const char* source;
+} Case;
+
+static const Case cases[] = {
+    {"conversion of a string", "text x {num} \"3\";\n"},
+    {"conversion of a name", "function leaf { nothing; }\ntext x {num} leaf;\n"},
+    {"conversion of a group", "text x {num} (1 + 2) * 3;\n"},
+    {"nested conversions", "text x {num} y {num} \"4\" + 1;\n"},
+    {"conversion in a body", "function f {\n  text x {num} \"2\" - 1;\n}\nf;\n"},
+    {"call before a body", "function f { nothing; }\nf;\nfunction g { f; }\ng;\n"},
+    {"name before other brace", "text x { 1 };\n"},
+    {"name before unclosed num", "text x {num \"3\";\n"},
+    {"name at end of input", "text 1;\nx"},
+    {"conversion at end of input", "text x {num}"},
+    {"brace at end of input", "text x {"},
+    {"stray brace", "text 1;\n}\ntext 2;\n"},
+    {"nested bodies", "function f {\n  function g { text { 1 }; }\n  g;\n}\nf;\n"},
+    {"bad body", "function f { text (; }\ntext 1;\n"},
+    {"unterminated body", "function f { text 1;\n  function g { text 2; }\n"},
+};
+
+#define CASE_COUNT (int)(sizeof(cases) / sizeof(cases[0]))
+
+static ParseResult parse(const char* source, Interner* strings, bool buffered, bool lazy) {
+    Lexer* lexer = create_lexer_with_length(source, strlen(source));
+    Parser* parser = buffered ? create_buffered_parser(lexer, strings) : create_parser(lexer, strings);
+    parser->lazy_functions = lazy;
+    ParseResult result = finish_parse(parser);
+    free_lexer(lexer);
+    return result;
+}
+
+int main(void) {
+    for (int i = 0; i < CASE_COUNT; i++) {
+        for (int lazy = 0; lazy <= 1; lazy++) {
+            const Case* c = &cases[i];
+            char name[128];
+            snprintf(name, sizeof(name), "%s%s", c->name, lazy ? " (lazy)" : "");
+            Interner strings;
+            init_interner(&strings);
+
+            ParseResult streaming = parse(c->source, &strings, false, lazy);
+            ParseResult buffered = parse(c->source, &strings, true, lazy);
+            check_same_parse(name, &streaming, &buffered);
+
+            // Bodies parsed later come out the same too
+            if (lazy && !streaming.had_error && !buffered.had_error) {
+                ASTNode* a = streaming.program->data.program.statements[0];
+                ASTNode* b = buffered.program->data.program.statements[0];
+                if (a && a->type == NODE_FUNCTION_DEFINITION) {
+                    CHECK(ast_equal(parse_function_body(a), parse_function_body(b)),
+                          "%s: lazy bodies differ", name);
+                }
+            }
+
+            free_parse_result(&streaming);
+            free_parse_result(&buffered);
+            free_interner(&strings);
+        }
+    }
+
+    // A lexing error ends a buffered parse's tokens; skipping a lazy body
+    // must stop there instead of waiting for a closing brace
+    Interner strings;
+    init_interner(&strings);
+    ParseResult stopped = parse("function f { text @; }\n", &strings, true, true);
+    CHECK(stopped.had_error, "lazy body with a bad character parsed");
+    free_parse_result(&stopped);
+    free_interner(&strings);
+
+    // The lookahead must actually take the conversion branch
+    init_interner(&strings);
+    Lexer lexer;
+    const char* source = "text x {num} \"3\";\n";
+    init_lexer(&lexer, source, strlen(source));
+    ParseResult result = finish_parse(create_buffered_parser(&lexer, &strings));
+    ASTNode* text = result.program && result.program->data.program.statement_count == 1
+                        ? result.program->data.program.statements[0]
+                        : NULL;
+    CHECK(text && text->type == NODE_TEXT && text->data.text.expr &&
+          text->data.text.expr->type == NODE_NUMBER_CONVERSION,
+          "buffered parse did not see the number conversion");
+    free_parse_result(&result);
+    free_interner(&strings);
+
+    return check_result("buffered_parse_check");
+}
@@ -0,0 +1,145 @@
+// Helpers shared by the front-end checks. Each check is a standalone
+// program that compares two ways of producing the same result and exits
+// non-zero if any case differs (make check).
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parser.h"
+
+static int check_failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            check_failures++; \
+        } \
+    } while (0)
+
+static inline int check_result(const char* name) {
+    if (check_failures > 0) {
+        fprintf(stderr, "%s: %d failures\n", name, check_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+static inline bool same_string(const char* a, const char* b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static inline bool ast_equal(const ASTNode* a, const ASTNode* b);
+
+// Bodies skipped by lazy parsers cover the same source text
+static inline bool lazy_equal(const LazyBody* a, const LazyBody* b) {
+    if (!a || !b) return a == b;
+    return a->length == b->length && a->line == b->line && a->column == b->column &&
+           memcmp(a->source, b->source, a->length) == 0;
+}
+
+static inline bool ast_lists_equal(ASTNode** a, int a_count, ASTNode** b, int b_count) {
+    if (a_count != b_count) return false;
+    for (int i = 0; i < a_count; i++) {
+        if (!ast_equal(a[i], b[i])) return false;
+    }
+    return true;
+}
+
+// Structural equality of two trees, lines included. Strings compare by
+// content, so the trees may come from different interners.
+static inline bool ast_equal(const ASTNode* a, const ASTNode* b) {
+    if (!a || !b) return a == b;
+    if (a->type != b->type || a->line != b->line) return false;
+
+    switch (a->type) {
+        case NODE_PROGRAM:
+            return ast_lists_equal(a->data.program.statements, a->data.program.statement_count,
+                                   b->data.program.statements, b->data.program.statement_count);
+        case NODE_FUNCTION_DEFINITION:
+            return same_string(a->data.function_definition.name, b->data.function_definition.name) &&
+                   ast_equal(a->data.function_definition.body, b->data.function_definition.body) &&
+                   lazy_equal(a->data.function_definition.lazy, b->data.function_definition.lazy);
+        case NODE_TEXT:
+            return same_string(a->data.text.content, b->data.text.content) &&
+                   ast_equal(a->data.text.expr, b->data.text.expr);
+        case NODE_STRING_LITERAL:
+            return same_string(a->data.string_literal.value, b->data.string_literal.value);
+        case NODE_NUMBER:
+            return a->data.number.value == b->data.number.value;
+        case NODE_IDENTIFIER:
+            return same_string(a->data.identifier.name, b->data.identifier.name);
+        case NODE_INPUT:
+            return same_string(a->data.input.prompt, b->data.input.prompt);
+        case NODE_NUMBER_CONVERSION:
+            return ast_equal(a->data.number_conversion.expr, b->data.number_conversion.expr);
+        case NODE_GAME_ENGINE:
+            return ast_lists_equal(a->data.game_engine.animations, a->data.game_engine.animation_count,
+                                   b->data.game_engine.animations, b->data.game_engine.animation_count) &&
+                   ast_equal(a->data.game_engine.expr, b->data.game_engine.expr);
+        case NODE_ANIMATION:
+            return same_string(a->data.animation.emoji, b->data.animation.emoji) &&
+                   same_string(a->data.animation.action, b->data.animation.action) &&
+                   a->data.animation.distance == b->data.animation.distance &&
+                   a->data.animation.repeat == b->data.animation.repeat &&
+                   a->data.animation.speed == b->data.animation.speed;
+        case NODE_BOOLEAN:
+            return a->data.boolean.value == b->data.boolean.value;
+        case NODE_UNARY:
+            return a->data.unary.op == b->data.unary.op &&
+                   ast_equal(a->data.unary.operand, b->data.unary.operand);
+        case NODE_BINARY:
+            return a->data.binary.op == b->data.binary.op &&
+                   ast_equal(a->data.binary.left, b->data.binary.left) &&
+                   ast_equal(a->data.binary.right, b->data.binary.right);
+        default:
+            return true;
+    }
+}
+
+// A finished parse: the tree, whether it failed, and its diagnostics
+typedef struct {
+    ASTNode* program;
+    bool had_error;
+    char* errors;
+    size_t errors_size;
+} ParseResult;
+
+// Parse with parser, capturing its diagnostics, then free the parser
+static inline ParseResult finish_parse(Parser* parser) {
+    ParseResult result = {NULL, false, NULL, 0};
+    parser->errors = open_memstream(&result.errors, &result.errors_size);
+    if (!parser->errors) {
+        fprintf(stderr, "Could not capture diagnostics\n");
+        exit(1);
+    }
+    result.program = parse_program(parser);
+    result.had_error = parser->had_error;
+    fclose(parser->errors);
+    free_parser(parser);
+    return result;
+}
+
+static inline void free_parse_result(ParseResult* result) {
+    free_ast(result->program);
+    free(result->errors);
+}
+
+// Both parses agree on the tree, even one cut short by an error, the
+// outcome and every diagnostic
+static inline void check_same_parse(const char* name, const ParseResult* expected, const ParseResult* actual) {
+    CHECK(expected->had_error == actual->had_error, "%s: had_error %d vs %d", name,
+          expected->had_error, actual->had_error);
+    CHECK(expected->errors_size == actual->errors_size &&
+          memcmp(expected->errors, actual->errors, expected->errors_size) == 0,
+          "%s: diagnostics differ:\n--- expected\n%s--- actual\n%s", name,
+          expected->errors, actual->errors);
+    CHECK(ast_equal(expected->program, actual->program), "%s: trees differ", name);
+}
+
+#endif // CHECK_H
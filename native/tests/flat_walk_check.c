@@ -0,0 +1,247 @@
+// Flat walker check: each script is run by the pointer tree walker and by
+// the flat walker in fresh VMs, and both must print the same thing,
+// diagnostics included, and finish with the same status; the
+// flat tree must also print like the pointer tree. Functions defined by
+// one walker are never called by the other, even in the same VM, and
+// neither leaves an object behind for each animation it renders.
+#include "check.h"
+#include "vm.h"
+#include <unistd.h>
+
+// Output written to stdout and stderr between begin_capture and
+// end_capture, interleaved as it was written
+typedef struct {
+    int saved_out;
+    int saved_err;
+    FILE* file;
+} Capture;
+
+static Capture begin_capture(void) {
+    Capture capture;
+    fflush(stdout);
+    fflush(stderr);
+    capture.saved_out = dup(STDOUT_FILENO);
+    capture.saved_err = dup(STDERR_FILENO);
+    capture.file = tmpfile();
+    if (capture.saved_out < 0 || capture.saved_err < 0 || !capture.file) {
+        fprintf(stderr, "Could not capture output\n");
+        exit(1);
+    }
+    dup2(fileno(capture.file), STDOUT_FILENO);
+    dup2(fileno(capture.file), STDERR_FILENO);
+    return capture;
+}
+
+// The captured text; the caller frees it
+static char* end_capture(Capture* capture) {
+    fflush(stdout);
+    fflush(stderr);
+    dup2(capture->saved_out, STDOUT_FILENO);
+    dup2(capture->saved_err, STDERR_FILENO);
+    close(capture->saved_out);
+    close(capture->saved_err);
+
+    long size = ftell(capture->file);
+    char* text = (char*)malloc(size + 1);
+    rewind(capture->file);
+    size_t read = fread(text, 1, size, capture->file);
+    text[read] = '\0';
+    fclose(capture->file);
+    return text;
+}
+
+static ASTNode* parse(VM* vm, const char* source) {
+    Lexer lexer;
+    init_lexer(&lexer, source, strlen(source));
+    ParseResult result = finish_parse(create_buffered_parser(&lexer, &vm->strings));
+    free(result.errors);
+    if (result.had_error) {
+        fprintf(stderr, "Check script failed to parse:\n%s\n", source);
+        exit(1);
+    }
+    return result.program;
+}
+
+// What the pointer walker prints running source; status gets what
+// execute_program returned
+static char* run_tree(const char* source, int* status) {
+    VM vm;
+    initVM(&vm);
+    ASTNode* program = parse(&vm, source);
+    Capture capture = begin_capture();
+    *status = execute_program(&vm, program);
+    flush_output(&vm.output);
+    char* text = end_capture(&capture);
+    free_ast(program);
+    freeVM(&vm);
+    return text;
+}
+
+// What the flat walker prints running source; status gets what
+// execute_flat_program returned
+static char* run_flat(const char* source, int* status) {
+    VM vm;
+    initVM(&vm);
+    ASTNode* program = parse(&vm, source);
+    FlatAST* ast = flatten_ast(program);
+    Capture capture = begin_capture();
+    *status = execute_flat_program(&vm, ast);
+    flush_output(&vm.output);
+    char* text = end_capture(&capture);
+    free_flat_ast(ast);
+    free_ast(program);
+    freeVM(&vm);
+    return text;
+}
+
+static void check_same_print(const char* name, const char* source) {
+    VM vm;
+    initVM(&vm);
+    ASTNode* program = parse(&vm, source);
+    FlatAST* ast = flatten_ast(program);
+
+    Capture capture = begin_capture();
+    print_ast(program, 0);
+    char* tree = end_capture(&capture);
+    capture = begin_capture();
+    print_flat_ast(ast, ast->root, 0);
+    char* flat = end_capture(&capture);
+    CHECK(strcmp(tree, flat) == 0, "%s: trees print differently:\n--- pointer\n%s--- flat\n%s",
+          name, tree, flat);
+
+    free(tree);
+    free(flat);
+    free_flat_ast(ast);
+    free_ast(program);
+    freeVM(&vm);
+}
+
+// Calls f0 through f<depth - 1>, each calling the next before printing
+static char* call_chain(int depth) {
+    size_t size = (size_t)depth * 64 + 64;
+    char* source = (char*)malloc(size);
+    size_t n = 0;
+    for (int i = 0; i < depth - 1; i++) {
+        n += (size_t)snprintf(source + n, size - n, "function f%d { f%d; text %d; }\n", i, i + 1, i);
+    }
+    n += (size_t)snprintf(source + n, size - n, "function f%d { text \"bottom\"; }\nf0;\n", depth - 1);
+    return source;
+}
+
+typedef struct {
+    const char* name;
+    const char* source;
+    bool fails;              // Stops on a runtime error
+} Case;
+
+static const Case cases[] = {
+    {"prints", "text \"hello\";\ntext \"a\" + \"b\";\ntext 1 < 2;\ntext -(x {num} \"2.5\");\n", false},
+    {"calls", "function greet {\n  text \"hi \" + \"there\";\n  inner;\n}\n"
+              "function inner { text \"inner\"; function late { text \"late!\"; } }\n"
+              "greet;\nlate;\ngreet;\n", false},
+    {"tail calls", "function a { text \"a\"; b; }\nfunction b { text \"b\"; c; }\n"
+                   "function c { text \"c\"; }\na;\na;\n", false},
+    {"redefinition", "function f { text 1; }\nf;\nfunction f { text 2; }\nf;\n", false},
+    {"undefined call", "missing;\ntext \"still here\";\n", false},
+    {"names as values", "function f { text 1; }\ntext f == f;\ntext (x {num} \"4\") / 2;\n", false},
+    {"expression statements", "x {num} \"42\";\nfunction f { x {num} y {num} \"7\" < 2; }\nf;\n"
+                              "text \"done\";\n", false},
+    {"type errors", "text \"one\";\ntext \"a\" - 1;\ntext -\"b\";\ntext \"two\";\n", false},
+    {"endless recursion", "function f { f; text \"x\"; }\nf;\ntext \"after\";\n", true},
+    {"endless recursion in a call", "function f { f; text \"x\"; }\nfunction g { text \"g\"; f; }\n"
+                                    "function h { g; text \"h\"; }\nh;\ntext \"after\";\n", true},
+};
+
+#define CASE_COUNT (int)(sizeof(cases) / sizeof(cases[0]))
+
+int main(void) {
+    for (int i = 0; i < CASE_COUNT; i++) {
+        int tree_status, flat_status;
+        char* tree = run_tree(cases[i].source, &tree_status);
+        char* flat = run_flat(cases[i].source, &flat_status);
+        CHECK(strcmp(tree, flat) == 0, "%s: walkers print differently:\n--- pointer\n%s--- flat\n%s",
+              cases[i].name, tree, flat);
+        CHECK((tree_status != 0) == cases[i].fails, "%s: pointer walker returned %d", cases[i].name,
+              tree_status);
+        CHECK((flat_status != 0) == cases[i].fails, "%s: flat walker returned %d", cases[i].name,
+              flat_status);
+        if (cases[i].fails) {
+            CHECK(!strstr(flat, "after") && strstr(flat, "Runtime error"),
+                  "%s: flat walker did not stop on the error:\n%s", cases[i].name, flat);
+        } else {
+            CHECK(!strstr(flat, "Unknown") && !strstr(flat, "error"),
+                  "%s: unexpected diagnostics:\n%s", cases[i].name, flat);
+        }
+        free(tree);
+        free(flat);
+        check_same_print(cases[i].name, cases[i].source);
+    }
+
+    // Warnings come after the output printed before them
+    int warned_status;
+    char* warned = run_flat("text \"one\";\ntext \"a\" - 1;\n", &warned_status);
+    CHECK(strncmp(warned, "one\nOperands", 12) == 0, "warning printed out of order:\n%s", warned);
+    free(warned);
+
+    // Deeper than the C stack would allow if calls recursed
+    char* chain = call_chain(50000);
+    int tree_status, flat_status;
+    char* tree = run_tree(chain, &tree_status);
+    char* flat = run_flat(chain, &flat_status);
+    CHECK(strcmp(tree, flat) == 0, "call chain: walkers print differently");
+    CHECK(strncmp(flat, "bottom\n", 7) == 0, "call chain: flat walker did not reach the bottom");
+    CHECK(tree_status == 0 && flat_status == 0, "call chain: walkers failed");
+    free(tree);
+    free(flat);
+    free(chain);
+
+    // Each walker skips the other's functions rather than misreading them
+    VM vm;
+    initVM(&vm);
+    ASTNode* tree_program = parse(&vm, "function t { text \"tree\"; }\n");
+    ASTNode* flat_program = parse(&vm, "function f { text \"flat\"; }\nt;\n");
+    ASTNode* calls = parse(&vm, "f;\n");
+    FlatAST* flat_ast = flatten_ast(flat_program);
+    Capture capture = begin_capture();
+    execute_program(&vm, tree_program);
+    execute_flat_program(&vm, flat_ast);
+    execute_program(&vm, calls);
+    flush_output(&vm.output);
+    char* mixed = end_capture(&capture);
+    CHECK(mixed[0] == '\0', "walkers called each other's functions: %s", mixed);
+    free(mixed);
+    free_flat_ast(flat_ast);
+    free_ast(tree_program);
+    free_ast(flat_program);
+    free_ast(calls);
+    freeVM(&vm);
+
+    // Animations are rendered without allocating, however often they run
+    char* engine = (char*)malloc(1000 * 8 + 64);
+    size_t n = (size_t)sprintf(engine, "function play { game_engine { \"x\" \"r\" \"fly\" 0 2 } }\n");
+    for (int i = 0; i < 1000; i++) n += (size_t)sprintf(engine + n, "play;\n");
+    for (int flat = 0; flat <= 1; flat++) {
+        initVM(&vm);
+        ASTNode* program = parse(&vm, engine);
+        FlatAST* ast = flatten_ast(program);
+        capture = begin_capture();
+        if (flat) {
+            execute_flat_program(&vm, ast);
+        } else {
+            execute_program(&vm, program);
+        }
+        flush_output(&vm.output);
+        char* rendered = end_capture(&capture);
+        CHECK(strstr(rendered, "r") != NULL, "game engine (%s): nothing rendered",
+              flat ? "flat" : "pointer");
+        CHECK(vm.objects == NULL, "game engine (%s): animations left objects behind",
+              flat ? "flat" : "pointer");
+        free(rendered);
+        free_flat_ast(ast);
+        free_ast(program);
+        freeVM(&vm);
+    }
+    free(engine);
+
+    return check_result("flat_walk_check");
+}
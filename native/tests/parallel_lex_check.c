@@ -0,0 +1,125 @@
+// Parallel lexing check: tokenize_parallel() must produce exactly the
+// tokens tokenize() does, field by field, for sources large enough to be
+// split. The sources put most of their bytes inside multi-line strings so
+// chunk boundaries land inside them, and stop lexing early with an
+// embedded NUL or a bad character.
+#include "check.h"
+
+#define SOURCE_SIZE (3 * PARALLEL_LEX_MIN_SOURCE)
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Source;
+
+static void append(Source* source, const char* text, size_t n) {
+    if (source->length + n + 1 > source->capacity) {
+        source->capacity = source->capacity * 2 + n + 1;
+        source->data = (char*)realloc(source->data, source->capacity);
+        if (!source->data) {
+            fprintf(stderr, "Failed to allocate check source\n");
+            exit(1);
+        }
+    }
+    memcpy(source->data + source->length, text, n);
+    source->length += n;
+    source->data[source->length] = '\0';
+}
+
+static void append_text(Source* source, const char* text) {
+    append(source, text, strlen(text));
+}
+
+// Ordinary statements of every token kind
+static Source statements(void) {
+    Source source = {NULL, 0, 0};
+    char line[256];
+    for (int i = 0; source.length < SOURCE_SIZE; i++) {
+        snprintf(line, sizeof(line),
+                 "function f%d {\n  text \"item %d\" + x {num} \"3\" * (2 - 1.5) / 4;\n"
+                 "  text %d <= 7 == !true != false >= 1 > 0 < 2;\n}\nf%d;\n",
+                 i, i, i, i);
+        append_text(&source, line);
+    }
+    return source;
+}
+
+// Multi-line strings holding nearly all of the source, so every even
+// split target falls inside one
+static Source long_strings(void) {
+    Source source = {NULL, 0, 0};
+    while (source.length < SOURCE_SIZE) {
+        append_text(&source, "text 1;\ntext \"");
+        for (int i = 0; i < 20000; i++) append_text(&source, "a line of the string\n");
+        append_text(&source, "\";\n");
+    }
+    return source;
+}
+
+typedef struct {
+    const char* name;
+    Source source;
+} Case;
+
+static void check_case(const Case* c, int threads) {
+    ThreadPool* pool = create_thread_pool(threads);
+    Lexer lexer;
+    init_lexer(&lexer, c->source.data, c->source.length);
+    TokenBuffer* expected = tokenize(&lexer);
+    TokenBuffer* actual = tokenize_parallel(c->source.data, c->source.length, pool);
+    free_thread_pool(pool);
+
+    CHECK(expected->count == actual->count, "%s, %d threads: %d tokens vs %d", c->name, threads,
+          expected->count, actual->count);
+    int count = expected->count < actual->count ? expected->count : actual->count;
+    for (int i = 0; i < count; i++) {
+        if (expected->types[i] != actual->types[i] || expected->offsets[i] != actual->offsets[i] ||
+            expected->lengths[i] != actual->lengths[i] || expected->lines[i] != actual->lines[i] ||
+            expected->columns[i] != actual->columns[i]) {
+            CHECK(false, "%s, %d threads: token %d is type %d at %zu+%u, %u:%u; expected type %d "
+                  "at %zu+%u, %u:%u", c->name, threads, i, actual->types[i], actual->offsets[i],
+                  actual->lengths[i], actual->lines[i], actual->columns[i], expected->types[i],
+                  expected->offsets[i], expected->lengths[i], expected->lines[i],
+                  expected->columns[i]);
+            break;
+        }
+    }
+
+    free_token_buffer(expected);
+    free_token_buffer(actual);
+}
+
+int main(void) {
+    Case cases[] = {
+        {"statements", statements()},
+        {"long strings", long_strings()},
+        {"NUL between statements", statements()},
+        {"NUL in a string", long_strings()},
+        {"bad character", statements()},
+        {"unterminated string", statements()},
+    };
+    int case_count = (int)(sizeof(cases) / sizeof(cases[0]));
+
+    // Lexing stops early in the middle of the source
+    Source* nul = &cases[2].source;
+    nul->data[strchr(nul->data + nul->length / 2, '\n') - nul->data + 1] = '\0';
+    Source* nul_string = &cases[3].source;
+    nul_string->data[nul_string->length / 2] = '\0';
+    Source* bad = &cases[4].source;
+    bad->data[strchr(bad->data + bad->length / 2, '\n') - bad->data + 1] = '@';
+    append_text(&cases[5].source, "text \"never closed\n");
+
+    // Sources too short to split go through tokenize() itself
+    CHECK(cases[0].source.length >= 2 * PARALLEL_LEX_MIN_SOURCE, "sources are too short to split");
+
+    int thread_counts[] = {1, 2, 4};
+    for (int i = 0; i < case_count; i++) {
+        for (int t = 0; t < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); t++) {
+            check_case(&cases[i], thread_counts[t]);
+        }
+        free(cases[i].source.data);
+    }
+
+    return check_result("parallel_lex_check");
+}
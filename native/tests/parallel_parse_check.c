@@ -0,0 +1,110 @@
+// Parallel parse check: every program is parsed from a token buffer
+// serially and with a thread pool, and the two must produce the same tree,
+// the same outcome and the same diagnostics. Errors are planted in
+// function bodies, between functions and at the end of the file, so the
+// merge has to stop at the same place the serial parser does.
+#include "check.h"
+
+#define FUNCTIONS 300
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Source;
+
+static void append(Source* source, const char* format, int arg) {
+    char line[256];
+    int n = snprintf(line, sizeof(line), format, arg);
+    if (source->length + n + 1 > source->capacity) {
+        source->capacity = source->capacity * 2 + n + 1;
+        source->data = (char*)realloc(source->data, source->capacity);
+        if (!source->data) {
+            fprintf(stderr, "Failed to allocate check source\n");
+            exit(1);
+        }
+    }
+    memcpy(source->data + source->length, line, n + 1);
+    source->length += n;
+}
+
+// Where to plant an error, as a function number, or -1 for none
+typedef struct {
+    const char* name;
+    int bad_body;            // Syntax error inside this function's body
+    int second_bad_body;     // Another one later, which must not be reported
+    int bad_statement;       // Syntax error in the statement after this function
+    int stray_brace;         // '}' after this function
+    int bad_character;       // Lexing error inside this function's body
+    bool unterminated;       // The last function never closes
+} Case;
+
+static char* build_program(const Case* c) {
+    Source source = {NULL, 0, 0};
+    append(&source, "text \"start\";\n", 0);
+    for (int i = 0; i < FUNCTIONS; i++) {
+        append(&source, "function f%d {\n", i);
+        append(&source, "  text \"body %d\" + x {num} \"2\" * 3;\n", i);
+        append(&source, "  function inner%d { text !true == false; }\n", i);
+        append(&source, "  inner%d;\n", i);
+        if (i % 7 == 0) append(&source, "  game_engine { \"x\" \"r\" \"fly\" %d }\n", i);
+        if (i == c->bad_body || i == c->second_bad_body) append(&source, "  text (;\n", 0);
+        if (i == c->bad_character) append(&source, "  text @;\n", 0);
+        if (i == FUNCTIONS - 1 && c->unterminated) break;
+        append(&source, "}\n", 0);
+
+        if (i == c->bad_statement) append(&source, "text ;\n", 0);
+        if (i == c->stray_brace) append(&source, "}\n", 0);
+        if (i % 10 == 0) append(&source, "f%d;\ntext \"top\";\n", i);
+    }
+    return source.data;
+}
+
+static const Case cases[] = {
+    {"valid", -1, -1, -1, -1, -1, false},
+    {"bad body", 150, -1, -1, -1, -1, false},
+    {"first body", 0, -1, -1, -1, -1, false},
+    {"two bad bodies", 100, 200, -1, -1, -1, false},
+    {"bad statement", -1, -1, 120, -1, -1, false},
+    {"bad statement before bad body", 250, -1, 120, -1, -1, false},
+    {"stray brace", -1, -1, -1, 180, -1, false},
+    {"bad character", -1, -1, -1, -1, 90, false},
+    {"unterminated", -1, -1, -1, -1, -1, true},
+};
+
+#define CASE_COUNT (int)(sizeof(cases) / sizeof(cases[0]))
+
+static ParseResult parse(const char* source, Interner* strings, ThreadPool* pool) {
+    Lexer lexer;
+    init_lexer(&lexer, source, strlen(source));
+    Parser* parser = create_buffered_parser(&lexer, strings);
+    parser->pool = pool;
+    return finish_parse(parser);
+}
+
+int main(void) {
+    int thread_counts[] = {1, 2, 4};
+    for (int t = 0; t < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); t++) {
+        ThreadPool* pool = create_thread_pool(thread_counts[t]);
+        for (int i = 0; i < CASE_COUNT; i++) {
+            char name[128];
+            snprintf(name, sizeof(name), "%s, %d threads", cases[i].name, thread_counts[t]);
+            char* source = build_program(&cases[i]);
+            Interner strings;
+            init_interner(&strings);
+
+            ParseResult serial = parse(source, &strings, NULL);
+            ParseResult parallel = parse(source, &strings, pool);
+            check_same_parse(name, &serial, &parallel);
+            CHECK(serial.had_error == (i != 0), "%s: unexpected outcome", name);
+
+            free_parse_result(&serial);
+            free_parse_result(&parallel);
+            free_interner(&strings);
+            free(source);
+        }
+        free_thread_pool(pool);
+    }
+
+    return check_result("parallel_parse_check");
+}